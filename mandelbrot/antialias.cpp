@@ -0,0 +1,211 @@
+// Adaptive anti-aliasing
+
+#include "antialias.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// sRGB to linear light for each 8-bit value.
+static const std::vector<float> &linear_table()
+{
+	static const std::vector<float> table = [] {
+		std::vector<float> t(256);
+		for (int i = 0; i < 256; ++i)
+		{
+			const double c = i / 255.0;
+			t[i] = (float) (c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+		}
+		return t;
+	}();
+	return table;
+}
+
+// Linear light back to an 8-bit sRGB value.
+static int to_srgb(double linear)
+{
+	const double c = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+	return std::clamp((int) std::lround(c * 255.0), 0, 255);
+}
+
+// Do two neighbouring pixels differ enough that there's an edge between them?
+// Either one is in the set and the other isn't, or one took more than
+// edgeRatio times as many iterations as the other.
+static bool is_edge(int a, int b, int maxIterations, double edgeRatio)
+{
+	if ((a == maxIterations) != (b == maxIterations))
+	{
+		return true;
+	}
+	const int low = std::min(a, b) + 1;
+	const int high = std::max(a, b) + 1;
+	return high > low * edgeRatio;
+}
+
+// A fixed pseudo-random number in [0, 1) for each (pixel, sample), so that
+// renders are repeatable.
+static double jitter(uint64_t pixel, int sample)
+{
+	uint64_t z = pixel * 0x9E3779B97F4A7C15ull + (uint64_t) sample * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	z ^= z >> 31;
+	return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+long long antialias_frame(const RenderSettings &settings, Frame &frame, int samplesPerSide, double edgeRatio)
+{
+	std::vector<size_t> edges;
+	for (int y = frame.firstRow; y < frame.firstRow + frame.rows; ++y)
+	{
+		const int *row = frame.row(y);
+		const int max = frame.maxIterations;
+		for (int x = 0; x < frame.width; ++x)
+		{
+			// Pixels in the set stay black; the pixels just outside it
+			// are enough to smooth the edge, and cost far less.
+			bool edge = row[x] != max && ((x > 0 && is_edge(row[x], row[x - 1], max, edgeRatio))
+				|| (x + 1 < frame.width && is_edge(row[x], row[x + 1], max, edgeRatio))
+				|| (y > frame.firstRow && is_edge(row[x], frame.row(y - 1)[x], max, edgeRatio))
+				|| (y + 1 < frame.firstRow + frame.rows && is_edge(row[x], frame.row(y + 1)[x], max, edgeRatio)));
+			if (edge)
+			{
+				edges.push_back((size_t) (y - frame.firstRow) * frame.width + x);
+			}
+		}
+	}
+
+	const View &view = settings.view;
+	const double pixelWidth = (view.right - view.left) / frame.width;
+	const double pixelHeight = (view.bottom - view.top) / frame.height;
+	const std::vector<float> &linear = linear_table();
+
+	// Each pixel has a grid of side x side samples, one somewhere in each
+	// cell. The coarse samples are one from each 2x2 block of cells, so
+	// they're a subset of the full grid and don't need computing again
+	// when a pixel turns out to need it.
+	const int side = samplesPerSide;
+	const int coarseSide = side >= 4 ? (side + 1) / 2 : 0;
+
+	// Work out where the samples of pixel "index" listed in cells[from, to)
+	// are, and compute them into iterations[from, to).
+	auto compute_cells = [&](size_t index, const std::vector<int> &cells, int from, int to,
+		std::vector<double> &re, std::vector<double> &im, std::vector<int> &iterations) {
+		const int x = (int) (index % frame.width);
+		const int y = frame.firstRow + (int) (index / frame.width);
+		for (int s = from; s < to; ++s)
+		{
+			const double u = (cells[s] % side + jitter(index, 2 * cells[s])) / side;
+			const double v = (cells[s] / side + jitter(index, 2 * cells[s] + 1)) / side;
+			re[s] = column_real(view, frame.width, x) + u * pixelWidth;
+			im[s] = row_imag(view, frame.height, y) + v * pixelHeight;
+		}
+		compute_points(*settings.kernel, settings.fractal, re.data() + from, im.data() + from, to - from,
+			frame.maxIterations, iterations.data() + from);
+	};
+
+	// Set pixel "index" to the average of the first n samples' colours.
+	auto average = [&](size_t index, const std::vector<int> &iterations, int n) {
+		double sum[3] = { 0.0, 0.0, 0.0 };
+		for (int s = 0; s < n; ++s)
+		{
+			const uint32_t colour = iteration_colour(iterations[s], frame.maxIterations);
+			for (int c = 0; c < 3; ++c)
+			{
+				sum[c] += linear[(colour >> (8 * c)) & 0xFF];
+			}
+		}
+
+		uint32_t colour = 0;
+		for (int c = 0; c < 3; ++c)
+		{
+			colour |= (uint32_t) to_srgb(sum[c] / n) << (8 * c);
+		}
+		frame.image[index] = colour;
+	};
+
+	// Edges are bunched together, so hand them out in small chunks.
+	const size_t CHUNK = 64;
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		const int samples = side * side;
+		std::vector<double> re(samples), im(samples);
+		std::vector<int> iterations(samples);
+		std::vector<int> cells(samples);
+		std::vector<bool> coarse(samples);
+
+		while (true)
+		{
+			const size_t start = next.fetch_add(CHUNK);
+			if (start >= edges.size())
+			{
+				break;
+			}
+			for (size_t e = start; e < std::min(start + CHUNK, edges.size()); ++e)
+			{
+				const size_t index = edges[e];
+
+				// Most edge pixels only have the edge near them, not
+				// through them, so try the coarse samples first. Which
+				// cell of each block they come from is chosen at random,
+				// so that together they still cover the whole pixel.
+				int n = 0;
+				std::fill(coarse.begin(), coarse.end(), false);
+				for (int by = 0; by < coarseSide; ++by)
+				{
+					for (int bx = 0; bx < coarseSide; ++bx)
+					{
+						const int pick = (int) (jitter(index, 2 * samples + by * coarseSide + bx) * 4);
+						const int cx = std::min(2 * bx + pick % 2, side - 1);
+						const int cy = std::min(2 * by + pick / 2, side - 1);
+						coarse[cy * side + cx] = true;
+						cells[n++] = cy * side + cx;
+					}
+				}
+				if (n > 0)
+				{
+					compute_cells(index, cells, 0, n, re, im, iterations);
+					bool smooth = true;
+					for (int s = 1; s < n && smooth; ++s)
+					{
+						smooth = !is_edge(iterations[s], iterations[0], frame.maxIterations, edgeRatio);
+					}
+					if (smooth)
+					{
+						average(index, iterations, n);
+						continue;
+					}
+				}
+
+				// Otherwise fill in the rest of the grid.
+				const int first = n;
+				for (int cell = 0; cell < samples; ++cell)
+				{
+					if (!coarse[cell])
+					{
+						cells[n++] = cell;
+					}
+				}
+				compute_cells(index, cells, first, samples, re, im, iterations);
+				average(index, iterations, samples);
+			}
+		}
+	};
+
+	const int threads = std::max(1, settings.threads);
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threads; ++t)
+	{
+		workers.push_back(std::thread(worker));
+	}
+	worker();
+	for (std::thread &thread : workers)
+	{
+		thread.join();
+	}
+
+	return (long long) edges.size();
+}
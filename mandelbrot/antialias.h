@@ -0,0 +1,25 @@
+// Adaptive anti-aliasing
+// Supersampling every pixel multiplies the cost of a render by the number of
+// samples, but only pixels on edges in the image actually need it. We render
+// at one sample per pixel, find the pixels whose iteration count differs
+// sharply from a neighbour's, and supersample just those.
+
+#pragma once
+
+#include "render.h"
+#include "scheduler.h"
+
+// A pixel outside the set is on an edge if a neighbour is in the set, or if
+// one of them took more than this many times as many iterations as the
+// other. Pixels in the set are never supersampled. At 2, nearly a fifth of
+// the pixels in the zoomed view counted as edges.
+const double DEFAULT_EDGE_RATIO = 4.0;
+
+// Supersample the edge pixels of a frame that has already been computed and
+// coloured, using a grid of samplesPerSide x samplesPerSide jittered samples
+// per pixel, and settings.kernel and settings.threads. Each pixel starts with
+// one sample from each 2x2 block of the grid, and only takes the rest if
+// those straddle an edge.
+// The samples' colours are averaged in linear light. Only frame.image changes.
+// Returns the number of pixels supersampled.
+long long antialias_frame(const RenderSettings &settings, Frame &frame, int samplesPerSide, double edgeRatio = DEFAULT_EDGE_RATIO);
@@ -0,0 +1,531 @@
+// Buddhabrot rendering
+
+#include "buddhabrot.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+// Mix a 64-bit value into a well-spread one (splitmix64).
+static uint64_t mix(uint64_t z)
+{
+	z += 0x9E3779B97F4A7C15ull;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+static uint64_t rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+FastRandom::FastRandom(uint64_t seed)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		seed = mix(seed);
+		s[i] = seed;
+	}
+}
+
+uint64_t FastRandom::next()
+{
+	const uint64_t result = s[0] + s[3];
+	const uint64_t t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+	return result;
+}
+
+// Follow the orbit of c for its first n iterations, calling visit(pixel)
+// each time it lands in a width x height image of the view.
+template <typename Visit>
+static void visit_orbit(double cr, double ci, int n, const View &view, int width, int height, Visit visit)
+{
+	// Pixels per unit on the complex plane.
+	const double scaleX = width / (view.right - view.left);
+	const double scaleY = height / (view.bottom - view.top);
+
+	// The same steps as kernel_scalar, so the orbit is the one it followed.
+	double x = 0.0, y = 0.0;
+	double x2 = 0.0, y2 = 0.0;
+	for (int i = 0; i < n; ++i)
+	{
+		const double xy = x * y;
+		y = (xy + xy) + ci;
+		x = (x2 - y2) + cr;
+		x2 = x * x;
+		y2 = y * y;
+
+		// Points just left of or above the view give small negative
+		// values, so compare before truncating.
+		const double px = (x - view.left) * scaleX;
+		const double py = (y - view.top) * scaleY;
+		if (px >= 0.0 && px < width && py >= 0.0 && py < height)
+		{
+			visit((size_t) py * width + (size_t) px);
+		}
+	}
+}
+
+long long trace_orbit(double cr, double ci, int n, const View &view, int width, int height, uint64_t *counts)
+{
+	long long visits = 0;
+	visit_orbit(cr, ci, n, view, width, height, [&](size_t pixel) {
+		++counts[pixel];
+		++visits;
+	});
+	return visits;
+}
+
+// Run func(t) on threads threads, the first on this one.
+template <typename Func>
+static void run_threads(int threads, Func func)
+{
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threads; ++t)
+	{
+		workers.push_back(std::thread(func, t));
+	}
+	func(0);
+	for (std::thread &thread : workers)
+	{
+		thread.join();
+	}
+}
+
+// Add up each thread's buffer into total, each thread taking a band of pixels.
+template <typename Buffer>
+static void reduce_buffers(const std::vector<Buffer> &buffers, Buffer &total)
+{
+	const int threads = (int) buffers.size();
+	const size_t pixels = total.size();
+	run_threads(threads, [&](int t) {
+		const size_t start = pixels * t / threads;
+		const size_t end = pixels * (t + 1) / threads;
+		for (const Buffer &buffer : buffers)
+		{
+			for (size_t i = start; i < end; ++i)
+			{
+				total[i] += buffer[i];
+			}
+		}
+	});
+}
+
+long long render_buddhabrot(const Kernel &kernel, const View &view, const Frame &frame, long long samples, int threads, uint64_t seed, VisitCounts &counts)
+{
+	const size_t pixels = (size_t) frame.width * frame.height;
+	const long long batches = (samples + BUDDHABROT_BATCH - 1) / BUDDHABROT_BATCH;
+	threads = (int) std::max(1LL, std::min((long long) threads, batches));
+
+	// Each thread has its own counts, so nothing is shared while the
+	// orbits are traced.
+	std::vector<VisitCounts> threadCounts(threads, VisitCounts(pixels, 0));
+	std::vector<long long> threadVisits(threads, 0);
+	std::atomic<long long> nextBatch(0);
+
+	const View &area = BUDDHABROT_SAMPLE_AREA;
+	auto worker = [&](int t) {
+		uint64_t *mine = threadCounts[t].data();
+		double re[BUDDHABROT_BATCH], im[BUDDHABROT_BATCH];
+		int iterations[BUDDHABROT_BATCH];
+		long long visits = 0;
+
+		for (long long batch = nextBatch++; batch < batches; batch = nextBatch++)
+		{
+			// Draw the batch's points, leaving out the ones we know are
+			// in the set.
+			FastRandom random(seed ^ mix(batch));
+			const int drawn = (int) std::min((long long) BUDDHABROT_BATCH, samples - batch * BUDDHABROT_BATCH);
+			int count = 0;
+			for (int i = 0; i < drawn; ++i)
+			{
+				const double cr = area.left + random.uniform() * (area.right - area.left);
+				const double ci = area.top + random.uniform() * (area.bottom - area.top);
+				if (!in_cardioid_or_bulb(cr, ci))
+				{
+					re[count] = cr;
+					im[count] = ci;
+					++count;
+				}
+			}
+
+			// Find out which of them escape, then go back over just
+			// those orbits.
+			kernel.func(re, im, count, frame.maxIterations, iterations);
+			for (int i = 0; i < count; ++i)
+			{
+				if (iterations[i] < frame.maxIterations)
+				{
+					visits += trace_orbit(re[i], im[i], iterations[i], view, frame.width, frame.height, mine);
+				}
+			}
+		}
+		threadVisits[t] = visits;
+	};
+
+	run_threads(threads, worker);
+
+	counts.assign(pixels, 0);
+	reduce_buffers(threadCounts, counts);
+
+	long long visits = 0;
+	for (long long v : threadVisits)
+	{
+		visits += v;
+	}
+	return visits;
+}
+
+// One Metropolis-Hastings chain.
+struct Chain
+{
+	explicit Chain(uint64_t seed) : random(seed) {}
+
+	FastRandom random;
+
+	// The current point, and the pixels its orbit visits.
+	double cr = 0.0, ci = 0.0;
+	std::vector<uint32_t> pixels;
+
+	// Steps left to take, including any burn-in.
+	long long stepsLeft = 0;
+
+	// Steps since burn-in that the chain has stayed at the current point.
+	long long held = 0;
+};
+
+// Add the visits of the steps a chain has spent at its current point.
+static void deposit(Chain &chain, double *density)
+{
+	if (chain.held == 0)
+	{
+		return;
+	}
+
+	// Each point is visited in proportion to its number of visits, so
+	// weight them down by the same amount.
+	const double weight = (double) chain.held / chain.pixels.size();
+	for (uint32_t pixel : chain.pixels)
+	{
+		density[pixel] += weight;
+	}
+	chain.held = 0;
+}
+
+// What a chain did, for MetropolisStats.
+struct ChainSummary
+{
+	bool started = false;
+	long long tries = 0;
+	long long steps = 0;
+	long long accepted = 0;
+
+	// The running mean and sum of squared differences from it of the log
+	// of the number of visits, after burn-in.
+	double mean = 0.0;
+	double m2 = 0.0;
+};
+
+// Find the pixels visited by the first n iterations of the orbit of c.
+static void orbit_pixels(double cr, double ci, int n, const View &view, const Frame &frame, std::vector<uint32_t> &pixels)
+{
+	pixels.clear();
+	visit_orbit(cr, ci, n, view, frame.width, frame.height, [&](size_t pixel) {
+		pixels.push_back((uint32_t) pixel);
+	});
+}
+
+// Look for a point to start the chain from: one whose orbit visits the view.
+static bool start_chain(Chain &chain, ChainSummary &summary, const Kernel &kernel, const View &view, const Frame &frame)
+{
+	const View &area = BUDDHABROT_SAMPLE_AREA;
+	double re[BUDDHABROT_BATCH], im[BUDDHABROT_BATCH];
+	int iterations[BUDDHABROT_BATCH];
+
+	while (summary.tries < METROPOLIS_START_TRIES)
+	{
+		int count = 0;
+		for (int i = 0; i < BUDDHABROT_BATCH; ++i)
+		{
+			const double cr = area.left + chain.random.uniform() * (area.right - area.left);
+			const double ci = area.top + chain.random.uniform() * (area.bottom - area.top);
+			if (!in_cardioid_or_bulb(cr, ci))
+			{
+				re[count] = cr;
+				im[count] = ci;
+				++count;
+			}
+		}
+
+		kernel.func(re, im, count, frame.maxIterations, iterations);
+		for (int i = 0; i < count; ++i)
+		{
+			if (iterations[i] < frame.maxIterations)
+			{
+				orbit_pixels(re[i], im[i], iterations[i], view, frame, chain.pixels);
+				if (!chain.pixels.empty())
+				{
+					chain.cr = re[i];
+					chain.ci = im[i];
+					summary.tries += i + 1;
+					summary.started = true;
+					return true;
+				}
+			}
+		}
+		summary.tries += BUDDHABROT_BATCH;
+	}
+	return false;
+}
+
+// Is c somewhere render_buddhabrot might draw it from?
+static bool in_sample_area(double cr, double ci)
+{
+	const View &area = BUDDHABROT_SAMPLE_AREA;
+	return cr >= area.left && cr <= area.right && ci >= area.bottom && ci <= area.top;
+}
+
+// Propose a point to move a chain to. Both kinds of proposal are as likely
+// to go from a to b as from b to a, so they cancel out of the acceptance
+// probability. A small step can leave BUDDHABROT_SAMPLE_AREA; the caller
+// must reject those, as a large step never goes there, and the uniform
+// sampler never draws them.
+static void propose(FastRandom &random, const Chain &chain, const View &view, double &cr, double &ci)
+{
+	const View &area = BUDDHABROT_SAMPLE_AREA;
+	if (random.uniform() < METROPOLIS_LARGE_STEP)
+	{
+		cr = area.left + random.uniform() * (area.right - area.left);
+		ci = area.top + random.uniform() * (area.bottom - area.top);
+		return;
+	}
+
+	// A step in a random direction. Its length is spread evenly on a log
+	// scale, from a tenth of the view's width down to 1/100000 of it, as
+	// the orbits through a zoomed view come from regions of c of all sizes.
+	const double width = std::fabs(view.right - view.left);
+	const double radius = 0.1 * width * std::exp(-std::log(10000.0) * random.uniform());
+	const double angle = 6.283185307179586 * random.uniform();
+	cr = chain.cr + radius * std::cos(angle);
+	ci = chain.ci + radius * std::sin(angle);
+}
+
+void render_buddhabrot_metropolis(const Kernel &kernel, const View &view, const Frame &frame, long long samples, int threads, uint64_t seed, VisitDensity &density, MetropolisStats &stats)
+{
+	const size_t pixels = (size_t) frame.width * frame.height;
+	threads = std::max(1, std::min(threads, METROPOLIS_CHAINS));
+
+	std::vector<VisitDensity> threadDensity(threads, VisitDensity(pixels, 0.0));
+	std::vector<ChainSummary> summaries(METROPOLIS_CHAINS);
+
+	auto worker = [&](int t) {
+		double *mine = threadDensity[t].data();
+
+		// This thread's chains, which it steps all together so that the
+		// proposals go through the kernel in one batch.
+		const int first = METROPOLIS_CHAINS * t / threads;
+		const int last = METROPOLIS_CHAINS * (t + 1) / threads;
+		std::vector<Chain> chains;
+		std::vector<ChainSummary> mySummaries(last - first);
+		for (int c = first; c < last; ++c)
+		{
+			Chain chain(seed ^ mix(c));
+			if (start_chain(chain, mySummaries[c - first], kernel, view, frame))
+			{
+				chain.stepsLeft = METROPOLIS_BURN_IN + samples * (c + 1) / METROPOLIS_CHAINS - samples * c / METROPOLIS_CHAINS;
+			}
+			chains.push_back(std::move(chain));
+		}
+
+		double re[METROPOLIS_CHAINS], im[METROPOLIS_CHAINS];
+		int iterations[METROPOLIS_CHAINS];
+		int index[METROPOLIS_CHAINS];
+		std::vector<uint32_t> proposed;
+
+		for (long long step = 0;; ++step)
+		{
+			// Propose a move for each chain that's still going.
+			int count = 0;
+			bool going = false;
+			for (int c = 0; c < (int) chains.size(); ++c)
+			{
+				Chain &chain = chains[c];
+				if (chain.stepsLeft == 0)
+				{
+					continue;
+				}
+				going = true;
+				double cr, ci;
+				propose(chain.random, chain, view, cr, ci);
+				if (in_sample_area(cr, ci) && !in_cardioid_or_bulb(cr, ci))
+				{
+					re[count] = cr;
+					im[count] = ci;
+					index[count] = c;
+					++count;
+				}
+			}
+			if (!going)
+			{
+				break;
+			}
+
+			kernel.func(re, im, count, frame.maxIterations, iterations);
+
+			// Move to the proposed point with probability (its visits) /
+			// (the current point's visits). Points that don't escape, whose
+			// orbits miss the view, or that weren't proposed to the kernel
+			// because they're outside the sample area or inside the set,
+			// have no visits.
+			int next = 0;
+			for (int c = 0; c < (int) chains.size(); ++c)
+			{
+				Chain &chain = chains[c];
+				if (chain.stepsLeft == 0)
+				{
+					continue;
+				}
+				ChainSummary &summary = mySummaries[c];
+
+				bool accept = false;
+				if (next < count && index[next] == c)
+				{
+					if (iterations[next] < frame.maxIterations)
+					{
+						orbit_pixels(re[next], im[next], iterations[next], view, frame, proposed);
+						accept = chain.random.uniform() * chain.pixels.size() < proposed.size();
+					}
+					if (accept)
+					{
+						deposit(chain, mine);
+						chain.cr = re[next];
+						chain.ci = im[next];
+						chain.pixels.swap(proposed);
+					}
+					++next;
+				}
+
+				--chain.stepsLeft;
+				if (step < METROPOLIS_BURN_IN)
+				{
+					continue;
+				}
+
+				++chain.held;
+				++summary.steps;
+				if (accept)
+				{
+					++summary.accepted;
+				}
+				const double x = std::log((double) chain.pixels.size());
+				const double delta = x - summary.mean;
+				summary.mean += delta / summary.steps;
+				summary.m2 += delta * (x - summary.mean);
+			}
+		}
+
+		for (Chain &chain : chains)
+		{
+			deposit(chain, mine);
+		}
+
+		std::copy(mySummaries.begin(), mySummaries.end(), summaries.begin() + first);
+	};
+
+	run_threads(threads, worker);
+
+	density.assign(pixels, 0.0);
+	reduce_buffers(threadDensity, density);
+
+	// Compare the variance within each chain with the variance between
+	// their means.
+	stats = MetropolisStats();
+	double meanOfMeans = 0.0, within = 0.0, steps = 0.0;
+	for (const ChainSummary &summary : summaries)
+	{
+		stats.startTries += summary.tries;
+		if (summary.started)
+		{
+			++stats.chains;
+			stats.steps += summary.steps;
+			stats.accepted += summary.accepted;
+			meanOfMeans += summary.mean;
+			within += summary.steps > 1 ? summary.m2 / (summary.steps - 1) : 0.0;
+			steps += summary.steps;
+		}
+	}
+	if (stats.chains > 1 && steps > stats.chains)
+	{
+		meanOfMeans /= stats.chains;
+		within /= stats.chains;
+		steps /= stats.chains;
+		double between = 0.0;
+		for (const ChainSummary &summary : summaries)
+		{
+			if (summary.started)
+			{
+				between += (summary.mean - meanOfMeans) * (summary.mean - meanOfMeans);
+			}
+		}
+		between /= stats.chains - 1;
+		const double pooled = (steps - 1) / steps * within + between;
+		stats.rHat = within > 0.0 ? std::sqrt(pooled / within) : 1.0;
+	}
+}
+
+// The share of visited pixels that are drawn at full brightness. A few
+// pixels can be visited far more than the rest, and scaling to those would
+// leave everything else dark.
+const double BRIGHTEST_SHARE = 0.001;
+
+// Colour the frame by how much each pixel was visited.
+template <typename Buffer>
+static void colour_visits(Frame &frame, const Buffer &visits)
+{
+	std::vector<double> visited;
+	for (auto v : visits)
+	{
+		if (v > 0)
+		{
+			visited.push_back((double) v);
+		}
+	}
+	double bright = 0.0;
+	if (!visited.empty())
+	{
+		auto nth = visited.begin() + (size_t) ((visited.size() - 1) * (1.0 - BRIGHTEST_SHARE));
+		std::nth_element(visited.begin(), nth, visited.end());
+		bright = *nth;
+	}
+
+	// The counts cover a huge range, so brightness goes with their square
+	// root to bring out the fainter orbits.
+	for (int y = frame.firstRow; y < frame.firstRow + frame.rows; ++y)
+	{
+		const auto *row = &visits[(size_t) y * frame.width];
+		uint32_t *out = frame.imageRow(y);
+		for (int x = 0; x < frame.width; ++x)
+		{
+			const int level = bright == 0.0 ? 0 : std::min(255, (int) std::lround(255.0 * std::sqrt(row[x] / bright)));
+			out[x] = (level << 16) | (level << 8) | level;
+		}
+	}
+}
+
+void colour_buddhabrot(Frame &frame, const VisitCounts &counts)
+{
+	colour_visits(frame, counts);
+}
+
+void colour_buddhabrot(Frame &frame, const VisitDensity &density)
+{
+	colour_visits(frame, density);
+}
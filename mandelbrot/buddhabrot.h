@@ -0,0 +1,107 @@
+// Buddhabrot rendering
+// Instead of colouring each point by how long it takes to escape, the
+// Buddhabrot picks random points c outside the set and counts how often their
+// orbits pass through each pixel on the way out.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "kernels.h"
+#include "render.h"
+
+// Uniform sampling wastes nearly all its points on zoomed-in views, since
+// hardly any orbits pass through a small window. The Metropolis-Hastings
+// sampler instead runs chains that wander between points whose orbits do
+// land in the view, and weights each orbit so that the image comes out the
+// same as uniform sampling would give.
+
+// Where the random points c are drawn from. Every point that escapes slowly
+// enough to matter is in here.
+const View BUDDHABROT_SAMPLE_AREA = { -2.0, 1.0, 1.5, -1.5 };
+
+// How many points each thread draws and runs through the kernel at once.
+const int BUDDHABROT_BATCH = 4096;
+
+// How many times an orbit visited each pixel, row-major like frame.iterations.
+// A long render of a small image can visit a pixel more than 2^32 times.
+typedef std::vector<uint64_t> VisitCounts;
+
+// The same for the Metropolis-Hastings sampler, where each orbit's visits are
+// weighted so that together they add up to one.
+typedef std::vector<double> VisitDensity;
+
+// The number of Metropolis-Hastings chains, shared out between the threads.
+// It doesn't depend on the thread count, so neither does the image.
+const int METROPOLIS_CHAINS = 64;
+
+// Steps each chain takes before its visits start being counted.
+const int METROPOLIS_BURN_IN = 1000;
+
+// The share of proposals drawn from the whole of BUDDHABROT_SAMPLE_AREA
+// rather than near the current point, so chains can't get stuck.
+const double METROPOLIS_LARGE_STEP = 0.1;
+
+// How long a chain may search BUDDHABROT_SAMPLE_AREA for a point whose orbit
+// lands in the view before giving up.
+const long long METROPOLIS_START_TRIES = 1LL << 24;
+
+// What happened in a Metropolis-Hastings render.
+struct MetropolisStats
+{
+	// Chains that found a point to start from.
+	int chains = 0;
+
+	// Points tried while looking for starting points.
+	long long startTries = 0;
+
+	// Steps taken after burn-in, across all chains, and how many of those
+	// moved to the proposed point.
+	long long steps = 0;
+	long long accepted = 0;
+
+	// The Gelman-Rubin statistic for the log of the number of visits each
+	// step's orbit makes to the view. It approaches 1 as the chains converge
+	// on the same distribution; above about 1.1 they need to run for longer.
+	double rHat = 0.0;
+};
+
+// Trace the orbit of c for its first n iterations, counting its visits to the
+// pixels of a width x height image of the view. Returns the visits counted.
+long long trace_orbit(double cr, double ci, int n, const View &view, int width, int height, uint64_t *counts);
+
+// A small, fast random number generator (xoshiro256+). Each batch of points
+// gets its own, seeded from the batch number.
+class FastRandom
+{
+public:
+	explicit FastRandom(uint64_t seed);
+
+	uint64_t next();
+
+	// A uniform number in [0, 1).
+	double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+	uint64_t s[4];
+};
+
+// Draw "samples" random points from BUDDHABROT_SAMPLE_AREA, find the ones
+// that escape within frame.maxIterations using the kernel, and count their
+// orbits' visits to the pixels of frame's view. Each thread counts into its
+// own buffer, and the buffers are added up in parallel at the end, so counts
+// is the same for a given seed whatever the thread count.
+// Returns the number of visits counted.
+long long render_buddhabrot(const Kernel &kernel, const View &view, const Frame &frame, long long samples, int threads, uint64_t seed, VisitCounts &counts);
+
+// Take "samples" steps of Metropolis-Hastings chains, after burn-in, over
+// points whose orbits escape within frame.maxIterations and visit frame's
+// view. Each point is chosen in proportion to its number of visits, and its
+// visits are weighted down by the same amount, so density is proportional
+// to what render_buddhabrot would count.
+void render_buddhabrot_metropolis(const Kernel &kernel, const View &view, const Frame &frame, long long samples, int threads, uint64_t seed, VisitDensity &density, MetropolisStats &stats);
+
+// Colour the frame by its visit counts: brighter where orbits visit more.
+void colour_buddhabrot(Frame &frame, const VisitCounts &counts);
+void colour_buddhabrot(Frame &frame, const VisitDensity &density);
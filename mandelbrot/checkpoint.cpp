@@ -0,0 +1,298 @@
+// Checkpointing long renders so they can be resumed
+
+#include "checkpoint.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "symmetry.h"
+#include "tile_tracker.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+static const char CHECKPOINT_MAGIC[8] = { 'M', 'B', 'C', 'K', 'P', 'T', '2', '\n' };
+
+// Everything that has to match for a checkpoint to belong to a render.
+struct CheckpointHeader
+{
+	char magic[8];
+	int32_t width, height, maxIterations;
+	int32_t firstRow, rows;
+	int32_t tileRows;
+	int32_t symmetry;
+	int32_t tiles;
+	View view;
+	int32_t julia;
+	double juliaRe, juliaIm;
+	char kernel[32];
+};
+
+static CheckpointHeader make_header(const RenderSettings &settings, const Frame &frame, int tiles)
+{
+	CheckpointHeader header;
+	memset(&header, 0, sizeof header);
+	memcpy(header.magic, CHECKPOINT_MAGIC, sizeof header.magic);
+	header.width = frame.width;
+	header.height = frame.height;
+	header.maxIterations = frame.maxIterations;
+	header.firstRow = frame.firstRow;
+	header.rows = frame.rows;
+	header.tileRows = TILE_ROWS;
+	header.symmetry = settings.symmetry ? 1 : 0;
+	header.tiles = tiles;
+	header.view = settings.view;
+	header.julia = settings.fractal.julia ? 1 : 0;
+	header.juliaRe = settings.fractal.cRe;
+	header.juliaIm = settings.fractal.cIm;
+	strncpy(header.kernel, settings.kernel->name, sizeof header.kernel - 1);
+	return header;
+}
+
+// The checkpoint is written straight through the OS rather than with an
+// ofstream, so that it can be flushed to disk before it replaces the old
+// one. Otherwise a power cut just after the rename can leave an empty or
+// half-written file in its place.
+static int open_for_writing(const string &path)
+{
+#ifdef _WIN32
+	return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+	return open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+}
+
+static bool write_all(int fd, const void *data, size_t size)
+{
+	const char *pos = (const char *) data;
+	while (size > 0)
+	{
+#ifdef _WIN32
+		const int n = _write(fd, pos, (unsigned) std::min(size, (size_t) 1 << 30));
+#else
+		const ssize_t n = write(fd, pos, size);
+#endif
+		if (n <= 0)
+		{
+			return false;
+		}
+		pos += n;
+		size -= n;
+	}
+	return true;
+}
+
+// Flush the file to disk and close it. Returns false if either fails.
+static bool sync_and_close(int fd)
+{
+#ifdef _WIN32
+	const bool synced = _commit(fd) == 0;
+	return _close(fd) == 0 && synced;
+#else
+	const bool synced = fsync(fd) == 0;
+	return close(fd) == 0 && synced;
+#endif
+}
+
+// Flush the directory holding path, so that a rename into it is on disk.
+// Windows has no way to do this, and doesn't need one.
+static void sync_directory(const string &path)
+{
+#ifndef _WIN32
+	string dir = std::filesystem::path(path).parent_path().string();
+	int fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd >= 0)
+	{
+		fsync(fd);
+		close(fd);
+	}
+#endif
+}
+
+// Write the header, a byte per tile saying whether it's finished, and then
+// the iteration counts of each finished tile in turn.
+static void save_checkpoint(const string &path, const CheckpointHeader &header, const RowPlan &plan, const TileTracker &tracker, const Frame &frame)
+{
+	const string tmpPath = path + ".tmp";
+	int fd = open_for_writing(tmpPath);
+	bool ok = fd >= 0 && write_all(fd, &header, sizeof header);
+
+	// Take the snapshot of which tiles are done once, so the pixels we
+	// write agree with it even if more tiles finish meanwhile.
+	std::vector<char> done(plan.tiles.size());
+	for (size_t tile = 0; tile < plan.tiles.size(); ++tile)
+	{
+		done[tile] = tracker.done((int) tile) ? 1 : 0;
+	}
+	ok = ok && write_all(fd, done.data(), done.size());
+
+	for (size_t tile = 0; tile < plan.tiles.size() && ok; ++tile)
+	{
+		if (done[tile])
+		{
+			const int rows = plan.tiles[tile].second - plan.tiles[tile].first;
+			ok = write_all(fd, frame.row(plan.tiles[tile].first), (size_t) rows * frame.width * sizeof(int));
+		}
+	}
+
+	if (fd >= 0)
+	{
+		ok = sync_and_close(fd) && ok;
+	}
+	if (!ok)
+	{
+		cout << "Error writing to " << tmpPath << endl;
+		exit(1);
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tmpPath, path, error);
+	if (error)
+	{
+		cout << "Error renaming " << tmpPath << " to " << path << ": " << error.message() << endl;
+		exit(1);
+	}
+	sync_directory(path);
+}
+
+// Load the finished tiles from a checkpoint into the frame, marking them
+// done in the tracker. Returns the number of tiles loaded, or -1 if there's
+// no checkpoint.
+static int load_checkpoint(const string &path, const CheckpointHeader &expected, const RowPlan &plan, TileTracker &tracker, Frame &frame)
+{
+	std::ifstream in(path, std::ifstream::binary);
+	if (!in)
+	{
+		return -1;
+	}
+
+	CheckpointHeader header;
+	in.read((char *) &header, sizeof header);
+	if (!in || memcmp(&header, &expected, sizeof header) != 0)
+	{
+		cout << path << " is a checkpoint of a different render; remove it to start again." << endl;
+		exit(1);
+	}
+
+	std::vector<char> done(plan.tiles.size());
+	in.read(done.data(), done.size());
+
+	int loaded = 0;
+	for (size_t tile = 0; tile < plan.tiles.size() && in; ++tile)
+	{
+		if (done[tile])
+		{
+			const int rows = plan.tiles[tile].second - plan.tiles[tile].first;
+			in.read((char *) frame.row(plan.tiles[tile].first), (size_t) rows * frame.width * sizeof(int));
+			tracker.complete((int) tile);
+			++loaded;
+		}
+	}
+	if (!in)
+	{
+		cout << "Error reading " << path << endl;
+		exit(1);
+	}
+	return loaded;
+}
+
+// Compute tiles from the list until they run out, reporting each one to the tracker.
+static void checkpoint_worker(const RenderSettings &settings, Frame &frame, const RowPlan &plan, const std::vector<int> &todo, std::atomic<int> &next, TileTracker &tracker, std::atomic<int> &finished)
+{
+	while (true)
+	{
+		int i = next.fetch_add(1);
+		if (i >= (int) todo.size())
+		{
+			break;
+		}
+		const int tile = todo[i];
+		compute_mandelbrot(*settings.kernel, settings.view, frame, plan.tiles[tile].first, plan.tiles[tile].second, settings.fractal);
+		tracker.complete(tile);
+		finished.fetch_add(1, std::memory_order_release);
+	}
+}
+
+void render_checkpointed(const RenderSettings &settings, Frame &frame, const string &checkpointPath, double interval, bool resume)
+{
+	const RowPlan plan = plan_rows(settings, frame, TILE_ROWS);
+	const CheckpointHeader header = make_header(settings, frame, (int) plan.tiles.size());
+	TileTracker tracker((int) plan.tiles.size());
+
+	if (resume)
+	{
+		int loaded = load_checkpoint(checkpointPath, header, plan, tracker, frame);
+		if (loaded >= 0)
+		{
+			cout << "Resuming from " << checkpointPath << ": " << loaded << " of " << plan.tiles.size() << " tiles already done." << endl;
+		}
+	}
+
+	std::vector<int> todo;
+	for (int tile = 0; tile < tracker.tiles(); ++tile)
+	{
+		if (!tracker.done(tile))
+		{
+			todo.push_back(tile);
+		}
+	}
+
+	// The workers compute tiles while this thread saves checkpoints.
+	const int threads = std::max(1, settings.threads);
+	std::atomic<int> next(0);
+	std::atomic<int> finished(0);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t)
+	{
+		workers.push_back(std::thread(checkpoint_worker, std::cref(settings), std::ref(frame), std::cref(plan), std::cref(todo), std::ref(next), std::ref(tracker), std::ref(finished)));
+	}
+
+	typedef std::chrono::steady_clock the_clock;
+	const auto period = std::chrono::duration_cast<the_clock::duration>(std::chrono::duration<double>(interval));
+	the_clock::time_point lastSave = the_clock::now();
+	int saved = 0;
+	while (finished.load(std::memory_order_acquire) < (int) todo.size())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+		const int now = finished.load(std::memory_order_acquire);
+		if (the_clock::now() - lastSave >= period && now > saved)
+		{
+			save_checkpoint(checkpointPath, header, plan, tracker, frame);
+			lastSave = the_clock::now();
+			saved = now;
+		}
+	}
+
+	for (std::thread &worker : workers)
+	{
+		worker.join();
+	}
+
+	// Save the finished frame too, so that if writing the image fails the
+	// render doesn't have to be done again.
+	if (!todo.empty())
+	{
+		save_checkpoint(checkpointPath, header, plan, tracker, frame);
+	}
+
+	mirror_rows(plan, frame, frame.firstRow, frame.firstRow + frame.rows);
+}
@@ -0,0 +1,22 @@
+// Checkpointing long renders so they can be resumed
+// While a render runs, the finished tiles are saved to a checkpoint file
+// every so often. If the render is interrupted, running it again with the
+// same settings picks up from the last checkpoint instead of starting over.
+
+#pragma once
+
+#include <string>
+
+#include "render.h"
+#include "scheduler.h"
+
+// Compute the whole frame a tile of TILE_ROWS rows at a time, saving the
+// finished tiles to checkpointPath every "interval" seconds. The file is
+// written to a temporary name, flushed to disk, and then renamed over the
+// old one, so a crash or power cut while saving leaves the previous
+// checkpoint intact.
+// If resume is set and checkpointPath holds a checkpoint of the same render,
+// its tiles are loaded rather than computed again; a checkpoint of a
+// different render is an error. Tiles are always handed out dynamically.
+// The checkpoint is left in place; remove it once the image is safely written.
+void render_checkpointed(const RenderSettings &settings, Frame &frame, const std::string &checkpointPath, double interval, bool resume);
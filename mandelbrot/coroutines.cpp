@@ -0,0 +1,84 @@
+// Running render work as C++20 coroutines on a pool of threads
+
+#include "coroutines.h"
+
+CoroutinePool::CoroutinePool(int threads)
+	: stopping(false)
+{
+	for (int t = 0; t < threads; ++t)
+	{
+		workers.push_back(std::thread(&CoroutinePool::run, this));
+	}
+}
+
+CoroutinePool::~CoroutinePool()
+{
+	{
+		std::lock_guard<std::mutex> locked(queueLock);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (std::thread &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void CoroutinePool::post(std::coroutine_handle<> handle)
+{
+	{
+		std::lock_guard<std::mutex> locked(queueLock);
+		queue.push_back(handle);
+	}
+	wake.notify_one();
+}
+
+void CoroutinePool::run()
+{
+	while (true)
+	{
+		std::coroutine_handle<> handle;
+		{
+			std::unique_lock<std::mutex> locked(queueLock);
+			wake.wait(locked, [this] { return stopping || !queue.empty(); });
+			if (queue.empty())
+			{
+				return;
+			}
+			handle = queue.front();
+			queue.pop_front();
+		}
+		handle.resume();
+	}
+}
+
+bool AsyncMutex::wait(std::coroutine_handle<> handle)
+{
+	std::lock_guard<std::mutex> locked(guard);
+	if (!held)
+	{
+		held = true;
+		return false;
+	}
+	waiters.push_back(handle);
+	return true;
+}
+
+void AsyncMutex::unlock()
+{
+	std::coroutine_handle<> next;
+	{
+		std::lock_guard<std::mutex> locked(guard);
+		if (waiters.empty())
+		{
+			held = false;
+			return;
+		}
+		next = waiters.front();
+		waiters.pop_front();
+	}
+
+	// The lock stays held; it now belongs to the waiter.
+	pool.post(next);
+}
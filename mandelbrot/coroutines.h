@@ -0,0 +1,96 @@
+// Running render work as C++20 coroutines on a pool of threads
+
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The return type for a coroutine that starts running straight away and
+// frees itself when it finishes. Nothing waits on it directly, so it should
+// signal its own completion (e.g. with a std::latch).
+struct DetachedTask
+{
+	struct promise_type
+	{
+		DetachedTask get_return_object() { return {}; }
+		std::suspend_never initial_suspend() { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+// A fixed set of threads that resume coroutines.
+// A coroutine waiting for a thread is just a handle in the queue, so
+// thousands of them cost little more than their frames.
+class CoroutinePool
+{
+public:
+	explicit CoroutinePool(int threads);
+	~CoroutinePool();
+
+	// "co_await pool.schedule()" carries on running on one of the pool's threads.
+	auto schedule()
+	{
+		struct Awaiter
+		{
+			CoroutinePool &pool;
+			bool await_ready() { return false; }
+			void await_suspend(std::coroutine_handle<> handle) { pool.post(handle); }
+			void await_resume() {}
+		};
+		return Awaiter{ *this };
+	}
+
+	// Resume the coroutine on one of the pool's threads.
+	void post(std::coroutine_handle<> handle);
+
+private:
+	void run();
+
+	std::mutex queueLock;
+	std::condition_variable wake;
+	std::deque<std::coroutine_handle<>> queue;
+	bool stopping;
+	std::vector<std::thread> workers;
+};
+
+// A lock that suspends coroutines rather than blocking threads.
+// unlock() hands the lock straight to the next waiter and queues it on the
+// pool. Resuming it on the unlocking thread would save a hop, but each
+// waiter would then unlock and resume the next inside the last one's
+// stack frame, and a long queue would overflow the stack.
+class AsyncMutex
+{
+public:
+	explicit AsyncMutex(CoroutinePool &pool) : pool(pool) {}
+
+	// "co_await mutex.lock()" carries on once we hold the lock.
+	auto lock()
+	{
+		struct Awaiter
+		{
+			AsyncMutex &mutex;
+			bool await_ready() { return false; }
+			bool await_suspend(std::coroutine_handle<> handle) { return mutex.wait(handle); }
+			void await_resume() {}
+		};
+		return Awaiter{ *this };
+	}
+
+	void unlock();
+
+private:
+	// Take the lock if it's free and return false, or queue up and return true.
+	bool wait(std::coroutine_handle<> handle);
+
+	CoroutinePool &pool;
+	std::mutex guard;
+	bool held = false;
+	std::deque<std::coroutine_handle<>> waiters;
+};
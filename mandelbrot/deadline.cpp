@@ -0,0 +1,131 @@
+// Rendering to a frame-time budget
+
+#include "deadline.h"
+
+#include <algorithm>
+#include <chrono>
+
+typedef std::chrono::steady_clock the_clock;
+
+// The size of the probe render used to estimate how many iterations a frame
+// will need.
+const int PROBE_WIDTH = 64;
+const int PROBE_HEIGHT = 32;
+
+// Aim to finish the first pass in this share of the budget, as the model is
+// only an estimate.
+const double FIRST_PASS_SHARE = 0.7;
+
+// The fewest iterations the first pass may be cut down to.
+const int MIN_DEADLINE_ITERATIONS = 64;
+
+static double ms_since(the_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(the_clock::now() - start).count();
+}
+
+static double mean_iterations(const Frame &frame)
+{
+	return (double) frame_iterations(frame) / frame.iterations.size();
+}
+
+DeadlineRenderer::DeadlineRenderer(const RenderSettings &settings)
+	: settings(settings), msPerIteration(0.0), frameCount(0), hitCount(0)
+{
+}
+
+DeadlineFrame DeadlineRenderer::render_with_deadline(const View &view, int width, int height, int maxIterations, double budgetMs)
+{
+	const the_clock::time_point start = the_clock::now();
+	RenderSettings frameSettings = settings;
+	frameSettings.view = view;
+
+	// Probe how many iterations an average pixel of this view needs.
+	Frame probe(PROBE_WIDTH, PROBE_HEIGHT, maxIterations);
+	compute_mandelbrot(*settings.kernel, view, probe, 0, probe.height);
+	const double probeIterations = mean_iterations(probe);
+	if (msPerIteration == 0.0)
+	{
+		// No frames yet; assume every thread goes as fast as the probe did.
+		msPerIteration = ms_since(start) / (probeIterations * probe.iterations.size()) / std::max(1, settings.threads);
+	}
+
+	auto predict = [&](int scale, double iterations) {
+		const double pixels = (double) (width / scale) * (height / scale);
+		return pixels * iterations * msPerIteration;
+	};
+
+	// The largest scale that fits; failing that, the smallest scale with
+	// the iteration limit cut down to fit.
+	const double available = budgetMs * FIRST_PASS_SHARE - ms_since(start);
+	int scaleIndex = 0;
+	for (int i = 0; i < (int) (sizeof DEADLINE_SCALES / sizeof DEADLINE_SCALES[0]); ++i)
+	{
+		if (predict(DEADLINE_SCALES[i], probeIterations) <= available)
+		{
+			scaleIndex = i;
+		}
+	}
+	int iterations = maxIterations;
+	const double smallest = predict(DEADLINE_SCALES[0], probeIterations);
+	if (scaleIndex == 0 && smallest > available)
+	{
+		// Points never take more iterations than the limit, so cutting it
+		// cuts the time by at least as much.
+		iterations = std::max(MIN_DEADLINE_ITERATIONS, (int) (maxIterations * std::max(0.0, available) / smallest));
+	}
+
+	DeadlineFrame result;
+	while (true)
+	{
+		const int scale = DEADLINE_SCALES[scaleIndex];
+		const the_clock::time_point passStart = the_clock::now();
+		std::unique_ptr<Frame> frame(new Frame(std::max(1, width / scale), std::max(1, height / scale), iterations));
+		render_frame(frameSettings, *frame);
+		const double passMs = ms_since(passStart);
+
+		// Update the model from what the pass actually cost.
+		const double actualIterations = mean_iterations(*frame) * frame->iterations.size();
+		if (actualIterations > 0.0)
+		{
+			msPerIteration = 0.5 * msPerIteration + 0.5 * (passMs / actualIterations);
+		}
+
+		result.frame = std::move(frame);
+		result.scale = scale;
+		++result.passes;
+
+		// Sharpen if the next scale up should still finish in time.
+		const int last = (int) (sizeof DEADLINE_SCALES / sizeof DEADLINE_SCALES[0]) - 1;
+		if (scaleIndex == last || iterations < maxIterations
+			|| predict(DEADLINE_SCALES[scaleIndex + 1], probeIterations) > budgetMs - ms_since(start))
+		{
+			break;
+		}
+		++scaleIndex;
+	}
+
+	result.elapsedMs = ms_since(start);
+	result.hitDeadline = result.elapsedMs <= budgetMs;
+	++frameCount;
+	if (result.hitDeadline)
+	{
+		++hitCount;
+	}
+	return result;
+}
+
+void upscale_frame(const Frame &small, int scale, Frame &full)
+{
+	for (int y = full.firstRow; y < full.firstRow + full.rows; ++y)
+	{
+		const int sy = std::min(y / scale, small.height - 1);
+		int *out = full.row(y);
+		const int *in = small.row(sy);
+		for (int x = 0; x < full.width; ++x)
+		{
+			out[x] = in[std::min(x / scale, small.width - 1)];
+		}
+	}
+	full.maxIterations = small.maxIterations;
+}
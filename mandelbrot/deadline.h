@@ -0,0 +1,60 @@
+// Rendering to a frame-time budget
+// For interactive use, a frame that arrives on time at a lower resolution is
+// better than a sharp one that arrives late. The renderer keeps a model of
+// how long iterations take, picks a resolution and iteration limit that
+// should fit in the budget, and then sharpens the frame while time remains.
+
+#pragma once
+
+#include <memory>
+
+#include "render.h"
+#include "scheduler.h"
+
+// The scales a frame can be rendered at, as a divisor of its size.
+const int DEADLINE_SCALES[] = { 8, 4, 2, 1 };
+
+// A frame rendered by DeadlineRenderer.
+struct DeadlineFrame
+{
+	// The best render finished in time: width / scale x height / scale pixels.
+	std::unique_ptr<Frame> frame;
+	int scale = 1;
+
+	// Rendering passes done, including the first.
+	int passes = 0;
+
+	double elapsedMs = 0.0;
+	bool hitDeadline = false;
+};
+
+class DeadlineRenderer
+{
+public:
+	// settings.view is ignored; everything else is used for every frame.
+	explicit DeadlineRenderer(const RenderSettings &settings);
+
+	// Render a width x height image of the view within budgetMs, with up
+	// to maxIterations iterations. The first pass is at the largest
+	// resolution that the cost model says will fit in the budget, with
+	// fewer iterations if even the smallest won't. Later passes double the
+	// resolution for as long as the model says they'll fit in what's left.
+	DeadlineFrame render_with_deadline(const View &view, int width, int height, int maxIterations, double budgetMs);
+
+	int frames() const { return frameCount; }
+	int deadlinesHit() const { return hitCount; }
+
+private:
+	RenderSettings settings;
+
+	// Milliseconds of wall time per iteration of the escape loop, from
+	// the frames so far, or 0 before the first.
+	double msPerIteration;
+
+	int frameCount;
+	int hitCount;
+};
+
+// Copy a frame rendered at a smaller scale into a full-size frame, repeating
+// each pixel scale x scale times.
+void upscale_frame(const Frame &small, int scale, Frame &full);
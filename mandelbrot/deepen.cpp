@@ -0,0 +1,202 @@
+// Raising the iteration limit of a finished render
+
+#include "deepen.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "kernels.h"
+
+// Split [0, count) into "threads" contiguous chunks and run func(t, start, end)
+// on each in its own thread.
+static void run_split(int threads, size_t count, const std::function<void(int, size_t, size_t)> &func)
+{
+	threads = std::max(1, threads);
+	if (threads == 1)
+	{
+		func(0, 0, count);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t)
+	{
+		size_t start = count * t / threads;
+		size_t end = count * (t + 1) / threads;
+		workers.push_back(std::thread(func, t, start, end));
+	}
+	for (std::thread &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void render_saving_orbits(const View &view, Frame &frame, int threads, SavedOrbits &orbits)
+{
+	// Each thread collects the orbits from its own band of rows, and the
+	// bands are joined up in order afterwards.
+	threads = std::max(1, std::min(threads, frame.rows));
+	std::vector<SavedOrbits> bands(threads);
+
+	run_split(threads, frame.rows, [&](int t, size_t start, size_t end) {
+		SavedOrbits &band = bands[t];
+		std::vector<double> re(frame.width), im(frame.width);
+		std::vector<double> zRe(frame.width), zIm(frame.width);
+		for (int x = 0; x < frame.width; ++x)
+		{
+			re[x] = column_real(view, frame.width, x);
+		}
+
+		for (int y = frame.firstRow + (int) start; y < frame.firstRow + (int) end; ++y)
+		{
+			std::fill(im.begin(), im.end(), row_imag(view, frame.height, y));
+			std::fill(zRe.begin(), zRe.end(), 0.0);
+			std::fill(zIm.begin(), zIm.end(), 0.0);
+			int *iterations = frame.row(y);
+			std::fill(iterations, iterations + frame.width, 0);
+
+			kernel_resume(re.data(), im.data(), frame.width, frame.maxIterations, zRe.data(), zIm.data(), iterations);
+
+			for (int x = 0; x < frame.width; ++x)
+			{
+				if (iterations[x] == frame.maxIterations)
+				{
+					band.pixel.push_back((size_t) (y - frame.firstRow) * frame.width + x);
+					band.cRe.push_back(re[x]);
+					band.cIm.push_back(im[x]);
+					band.zRe.push_back(zRe[x]);
+					band.zIm.push_back(zIm[x]);
+				}
+			}
+		}
+	});
+
+	orbits = SavedOrbits();
+	for (const SavedOrbits &band : bands)
+	{
+		orbits.pixel.insert(orbits.pixel.end(), band.pixel.begin(), band.pixel.end());
+		orbits.cRe.insert(orbits.cRe.end(), band.cRe.begin(), band.cRe.end());
+		orbits.cIm.insert(orbits.cIm.end(), band.cIm.begin(), band.cIm.end());
+		orbits.zRe.insert(orbits.zRe.end(), band.zRe.begin(), band.zRe.end());
+		orbits.zIm.insert(orbits.zIm.end(), band.zIm.begin(), band.zIm.end());
+	}
+}
+
+void deepen_frame(Frame &frame, int maxIterations, int threads, SavedOrbits &orbits)
+{
+	if (maxIterations <= frame.maxIterations)
+	{
+		return;
+	}
+	if (orbits.size() == 0)
+	{
+		frame.maxIterations = maxIterations;
+		return;
+	}
+
+	// Every saved pixel has had frame.maxIterations iterations so far.
+	std::vector<int> iterations(orbits.size(), frame.maxIterations);
+	run_split(threads, orbits.size(), [&](int, size_t start, size_t end) {
+		kernel_resume(&orbits.cRe[start], &orbits.cIm[start], (int) (end - start), maxIterations,
+			&orbits.zRe[start], &orbits.zIm[start], &iterations[start]);
+		for (size_t i = start; i < end; ++i)
+		{
+			frame.iterations[orbits.pixel[i]] = iterations[i];
+		}
+	});
+	frame.maxIterations = maxIterations;
+
+	// Keep just the pixels that still haven't escaped.
+	size_t kept = 0;
+	for (size_t i = 0; i < orbits.size(); ++i)
+	{
+		if (iterations[i] == maxIterations)
+		{
+			orbits.pixel[kept] = orbits.pixel[i];
+			orbits.cRe[kept] = orbits.cRe[i];
+			orbits.cIm[kept] = orbits.cIm[i];
+			orbits.zRe[kept] = orbits.zRe[i];
+			orbits.zIm[kept] = orbits.zIm[i];
+			++kept;
+		}
+	}
+	orbits.pixel.resize(kept);
+	orbits.cRe.resize(kept);
+	orbits.cIm.resize(kept);
+	orbits.zRe.resize(kept);
+	orbits.zIm.resize(kept);
+}
+
+int choose_iterations(const View &view, int width, int height, int threads, double tolerance)
+{
+	// The probes are actual pixels, evenly spread over the image.
+	const int columns = std::min(width, 64);
+	const int rows = std::min(height, 64);
+	std::vector<double> re, im;
+	for (int j = 0; j < rows; ++j)
+	{
+		const int y = (int) (((long long) j * 2 + 1) * height / (rows * 2));
+		for (int i = 0; i < columns; ++i)
+		{
+			const int x = (int) (((long long) i * 2 + 1) * width / (columns * 2));
+			re.push_back(column_real(view, width, x));
+			im.push_back(row_imag(view, height, y));
+		}
+	}
+
+	const size_t count = re.size();
+	std::vector<double> zRe(count, 0.0), zIm(count, 0.0);
+	std::vector<int> iterations(count, 0);
+	const double allowed = tolerance * count;
+
+	int limit = 64;
+	int previous = 0;
+	while (true)
+	{
+		run_split(threads, count, [&](int, size_t start, size_t end) {
+			kernel_resume(&re[start], &im[start], (int) (end - start), limit,
+				&zRe[start], &zIm[start], &iterations[start]);
+		});
+
+		// How many escaped between the last limit and this one? In a deep
+		// zoom nothing may have escaped yet, which isn't convergence.
+		long long late = 0, escaped = 0;
+		for (int n : iterations)
+		{
+			if (n < limit)
+			{
+				++escaped;
+				if (n > previous)
+				{
+					++late;
+				}
+			}
+		}
+		if ((late <= allowed && escaped > allowed) || limit >= MAX_AUTO_ITERATIONS)
+		{
+			break;
+		}
+
+		previous = limit;
+		limit = std::min(limit * 2, MAX_AUTO_ITERATIONS);
+	}
+
+	// Find the smallest limit that only a few of the escaping probes need
+	// more than.
+	std::vector<int> escaped;
+	for (int n : iterations)
+	{
+		if (n < limit)
+		{
+			escaped.push_back(n);
+		}
+	}
+	if (escaped.empty())
+	{
+		return 64;
+	}
+	std::sort(escaped.begin(), escaped.end());
+	const size_t lose = std::min(escaped.size() - 1, (size_t) allowed);
+	return std::max(64, escaped[escaped.size() - 1 - lose] + 1);
+}
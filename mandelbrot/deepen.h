@@ -0,0 +1,50 @@
+// Raising the iteration limit of a finished render
+// With too few iterations, points near the set that take a long time to
+// escape come out black. Rather than render again from scratch with a higher
+// limit, we save where each pixel that hadn't escaped had got to, and carry
+// on just those pixels from there.
+// The same idea lets us pick the limit automatically, by deepening a sparse
+// grid of pixels until hardly any more of them escape.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "render.h"
+
+// The pixels of a frame that hadn't escaped after frame.maxIterations
+// iterations, and where they had got to.
+struct SavedOrbits
+{
+	// Index of each pixel in frame.iterations.
+	std::vector<size_t> pixel;
+
+	// The point c for each pixel, and z after frame.maxIterations iterations.
+	std::vector<double> cRe, cIm;
+	std::vector<double> zRe, zIm;
+
+	size_t size() const { return pixel.size(); }
+};
+
+// Compute the whole frame using "threads" threads, saving the orbits of the
+// pixels that don't escape. Every row is computed with kernel_resume, so the
+// results are the same as the scalar kernel's.
+void render_saving_orbits(const View &view, Frame &frame, int threads, SavedOrbits &orbits);
+
+// Raise frame.maxIterations to maxIterations, carrying on only the saved
+// pixels. The pixels that still haven't escaped stay in orbits, so this can
+// be done again. The frame ends up exactly as if it had been rendered with
+// maxIterations in the first place.
+void deepen_frame(Frame &frame, int maxIterations, int threads, SavedOrbits &orbits);
+
+// The most iterations choose_iterations will pick.
+const int MAX_AUTO_ITERATIONS = 1 << 20;
+
+// Pick an iteration limit for a width x height render of the view. A grid of
+// up to 64x64 of the image's pixels is iterated with a doubling limit until
+// some have escaped, and no more than "tolerance" of them escape in the last
+// doubling. The result
+// is then the smallest limit that loses no more than "tolerance" of the
+// pixels that escape, rather than the last doubling.
+int choose_iterations(const View &view, int width, int height, int threads, double tolerance = 0.001);
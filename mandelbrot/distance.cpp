@@ -0,0 +1,71 @@
+// Distance-estimation rendering
+
+#include "distance.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+// How many pixels away from the set the shading fades out.
+const double DISTANCE_FADE_PIXELS = 4.0;
+
+static void distance_worker(const DistanceKernel &kernel, const View &view, Frame &frame, std::vector<double> &distance, std::atomic<int> &nextRow)
+{
+	std::vector<double> re(frame.width), im(frame.width);
+	for (int x = 0; x < frame.width; ++x)
+	{
+		re[x] = column_real(view, frame.width, x);
+	}
+
+	while (true)
+	{
+		const int start = nextRow.fetch_add(TILE_ROWS);
+		if (start >= frame.firstRow + frame.rows)
+		{
+			break;
+		}
+		for (int y = start; y < std::min(start + TILE_ROWS, frame.firstRow + frame.rows); ++y)
+		{
+			std::fill(im.begin(), im.end(), row_imag(view, frame.height, y));
+			const size_t offset = (size_t) (y - frame.firstRow) * frame.width;
+			kernel.func(re.data(), im.data(), frame.width, frame.maxIterations, frame.row(y), &distance[offset]);
+		}
+	}
+}
+
+void render_distance(const DistanceKernel &kernel, const RenderSettings &settings, Frame &frame, std::vector<double> &distance)
+{
+	distance.assign(frame.iterations.size(), 0.0);
+	std::atomic<int> nextRow(frame.firstRow);
+
+	std::vector<std::thread> workers;
+	for (int t = 1; t < std::max(1, settings.threads); ++t)
+	{
+		workers.push_back(std::thread(distance_worker, std::cref(kernel), std::cref(settings.view), std::ref(frame), std::ref(distance), std::ref(nextRow)));
+	}
+	distance_worker(kernel, settings.view, frame, distance, nextRow);
+	for (std::thread &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+double pixel_size(const View &view, const Frame &frame)
+{
+	return std::fabs(view.right - view.left) / frame.width;
+}
+
+void colour_distance(Frame &frame, const std::vector<double> &distance, double pixelSize, int yPosSt, int yPosEnd)
+{
+	yPosSt = std::max(yPosSt, frame.firstRow);
+	yPosEnd = std::min(yPosEnd, frame.firstRow + frame.rows);
+
+	for (size_t i = (size_t) (yPosSt - frame.firstRow) * frame.width; i < (size_t) (yPosEnd - frame.firstRow) * frame.width; ++i)
+	{
+		// 0 on the boundary, 1 once we're far enough away.
+		const double t = std::min(1.0, distance[i] / (DISTANCE_FADE_PIXELS * pixelSize));
+		const uint32_t grey = (uint32_t) std::lround(255.0 * std::sqrt(t));
+		frame.image[i] = (grey << 16) | (grey << 8) | grey;
+	}
+}
@@ -0,0 +1,33 @@
+// Distance-estimation rendering
+// As well as the iteration count, a distance kernel estimates how far each
+// point is from the set. Shading by that distance draws the boundary as a
+// crisp line one pixel wide, without supersampling, and tells us which pixels
+// are far enough from the set to be uniform.
+
+#pragma once
+
+#include <vector>
+
+#include "kernels.h"
+#include "render.h"
+#include "scheduler.h"
+
+// Compute the iteration counts and distance estimates for the whole frame,
+// using settings.threads threads. settings.kernel and settings.scheduler are
+// ignored; rows are handed out dynamically in tiles of TILE_ROWS.
+// distance has an entry for each pixel, like frame.iterations.
+void render_distance(const DistanceKernel &kernel, const RenderSettings &settings, Frame &frame, std::vector<double> &distance);
+
+// The width of a pixel on the complex plane.
+double pixel_size(const View &view, const Frame &frame);
+
+// Is a pixel this far from the set far enough away that the set can't
+// affect it, so it can be treated as uniform?
+inline bool far_from_set(double distance, double pixelSize)
+{
+	return distance > pixelSize;
+}
+
+// Shade rows [yPosSt, yPosEnd) by their distance from the set: the set is
+// black, and the points around it fade to white over a few pixels.
+void colour_distance(Frame &frame, const std::vector<double> &distance, double pixelSize, int yPosSt, int yPosEnd);
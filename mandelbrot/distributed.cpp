@@ -0,0 +1,742 @@
+// Rendering across several processes over sockets
+
+#include "distributed.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using std::chrono::duration;
+using std::cout;
+using std::endl;
+using std::string;
+
+typedef std::chrono::steady_clock the_clock;
+
+#ifdef _WIN32
+
+void render_distributed(const RenderSettings &, Frame &, const string &, int, double)
+{
+	cout << "Distributed rendering needs POSIX sockets, which aren't available on this platform." << endl;
+	exit(1);
+}
+
+int run_worker(const string &, int)
+{
+	cout << "Distributed rendering needs POSIX sockets, which aren't available on this platform." << endl;
+	return 1;
+}
+
+#else
+
+// Message types.
+const uint8_t MSG_TILE = 1;   // coordinator -> worker: render these rows
+const uint8_t MSG_RESULT = 2; // worker -> coordinator: here are the iterations
+const uint8_t MSG_QUIT = 3;   // coordinator -> worker: no more tiles
+
+// The longest message we'll accept. A result is at most two 5-byte varints
+// per pixel of a TILE_ROWS x 65535 tile, so anything longer is garbage, and
+// buffering it would let one bad peer eat all our memory.
+const size_t MAX_MESSAGE_SIZE = 16 + (size_t) TILE_ROWS * 0xFFFF * 10;
+
+// Messages are a 4-byte length followed by that many bytes of payload.
+// Numbers are little-endian whatever the host, so workers on other machines
+// can join in.
+class MessageWriter
+{
+public:
+	void u8(uint8_t v) { data.push_back(v); }
+
+	void u32(uint32_t v)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			data.push_back((uint8_t) (v >> (8 * i)));
+		}
+	}
+
+	void f64(double v)
+	{
+		uint64_t bits;
+		memcpy(&bits, &v, sizeof bits);
+		for (int i = 0; i < 8; ++i)
+		{
+			data.push_back((uint8_t) (bits >> (8 * i)));
+		}
+	}
+
+	void str(const string &s)
+	{
+		u32((uint32_t) s.size());
+		data.insert(data.end(), s.begin(), s.end());
+	}
+
+	// Unsigned LEB128, as used for the compressed iteration counts.
+	void varint(uint32_t v)
+	{
+		while (v >= 0x80)
+		{
+			data.push_back((uint8_t) (v | 0x80));
+			v >>= 7;
+		}
+		data.push_back((uint8_t) v);
+	}
+
+	// The message with its length prefix.
+	std::vector<uint8_t> framed() const
+	{
+		MessageWriter out;
+		out.u32((uint32_t) data.size());
+		out.data.insert(out.data.end(), data.begin(), data.end());
+		return out.data;
+	}
+
+	std::vector<uint8_t> data;
+};
+
+class MessageReader
+{
+public:
+	MessageReader(const uint8_t *data, size_t size) : pos(data), end(data + size) {}
+
+	uint8_t u8()
+	{
+		return need(1) ? *pos++ : 0;
+	}
+
+	uint32_t u32()
+	{
+		uint32_t v = 0;
+		if (need(4))
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				v |= (uint32_t) *pos++ << (8 * i);
+			}
+		}
+		return v;
+	}
+
+	double f64()
+	{
+		uint64_t bits = 0;
+		if (need(8))
+		{
+			for (int i = 0; i < 8; ++i)
+			{
+				bits |= (uint64_t) *pos++ << (8 * i);
+			}
+		}
+		double v;
+		memcpy(&v, &bits, sizeof v);
+		return v;
+	}
+
+	string str()
+	{
+		uint32_t size = u32();
+		if (!need(size))
+		{
+			return "";
+		}
+		string s((const char *) pos, size);
+		pos += size;
+		return s;
+	}
+
+	uint32_t varint()
+	{
+		uint32_t v = 0;
+		for (int shift = 0; shift < 35 && need(1); shift += 7)
+		{
+			uint8_t byte = *pos++;
+			v |= (uint32_t) (byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				break;
+			}
+		}
+		return v;
+	}
+
+	bool ok() const { return valid; }
+
+private:
+	bool need(size_t n)
+	{
+		if ((size_t) (end - pos) < n)
+		{
+			valid = false;
+		}
+		return valid;
+	}
+
+	const uint8_t *pos;
+	const uint8_t *end;
+	bool valid = true;
+};
+
+// Open a socket for the given address, either listening on it or connected to it.
+// Returns -1 on failure.
+static int open_socket(const string &address, bool listening)
+{
+	if (address.compare(0, 5, "unix:") == 0)
+	{
+		const string path = address.substr(5);
+		sockaddr_un addr = {};
+		addr.sun_family = AF_UNIX;
+		if (path.empty() || path.size() >= sizeof addr.sun_path)
+		{
+			return -1;
+		}
+		memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0)
+		{
+			return -1;
+		}
+		if (listening)
+		{
+			unlink(path.c_str());
+			if (bind(fd, (sockaddr *) &addr, sizeof addr) == 0 && listen(fd, 64) == 0)
+			{
+				return fd;
+			}
+		}
+		else if (connect(fd, (sockaddr *) &addr, sizeof addr) == 0)
+		{
+			return fd;
+		}
+		close(fd);
+		return -1;
+	}
+
+	size_t colon = address.rfind(':');
+	if (colon == string::npos)
+	{
+		return -1;
+	}
+	const string host = address.substr(0, colon);
+	const string port = address.substr(colon + 1);
+
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = listening ? AI_PASSIVE : 0;
+	addrinfo *found = nullptr;
+	if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found) != 0)
+	{
+		return -1;
+	}
+
+	int fd = -1;
+	for (addrinfo *ai = found; ai != nullptr; ai = ai->ai_next)
+	{
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd < 0)
+		{
+			continue;
+		}
+
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+		if (listening)
+		{
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+			if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 64) == 0)
+			{
+				break;
+			}
+		}
+		else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+		{
+			break;
+		}
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(found);
+	return fd;
+}
+
+static bool send_all(int fd, const std::vector<uint8_t> &data)
+{
+	size_t sent = 0;
+	while (sent < data.size())
+	{
+		ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+		if (n <= 0)
+		{
+			return false;
+		}
+		sent += n;
+	}
+	return true;
+}
+
+static bool recv_all(int fd, uint8_t *data, size_t size)
+{
+	size_t got = 0;
+	while (got < size)
+	{
+		ssize_t n = recv(fd, data + got, size - got, 0);
+		if (n <= 0)
+		{
+			return false;
+		}
+		got += n;
+	}
+	return true;
+}
+
+// Read one whole message. Returns false if the connection has gone.
+static bool recv_message(int fd, std::vector<uint8_t> &message)
+{
+	uint8_t header[4];
+	if (!recv_all(fd, header, 4))
+	{
+		return false;
+	}
+	MessageReader reader(header, 4);
+	const size_t size = reader.u32();
+	if (size > MAX_MESSAGE_SIZE)
+	{
+		return false;
+	}
+	message.resize(size);
+	return recv_all(fd, message.data(), message.size());
+}
+
+// Append rows [y0, y1) of iteration counts as (run length, value) pairs.
+// Escaped and interior regions are mostly long runs, so this shrinks well.
+static void compress_rows(const Frame &frame, int y0, int y1, MessageWriter &out)
+{
+	const int *it = frame.row(y0);
+	const int *end = it + (size_t) (y1 - y0) * frame.width;
+	while (it < end)
+	{
+		const int *run = it;
+		while (run < end && *run == *it)
+		{
+			++run;
+		}
+		out.varint((uint32_t) (run - it));
+		out.varint((uint32_t) *it);
+		it = run;
+	}
+}
+
+static bool decompress_rows(MessageReader &in, Frame &frame, int y0, int y1)
+{
+	int *it = frame.row(y0);
+	int *end = it + (size_t) (y1 - y0) * frame.width;
+	while (it < end && in.ok())
+	{
+		uint32_t length = in.varint();
+		int value = (int) in.varint();
+		if (length == 0 || length > (uint32_t) (end - it))
+		{
+			return false;
+		}
+		std::fill(it, it + length, value);
+		it += length;
+	}
+	return in.ok() && it == end;
+}
+
+int run_worker(const string &address, int threads)
+{
+	// The coordinator may not be listening yet, so keep trying for a while.
+	int fd = -1;
+	for (int attempt = 0; attempt < 100 && fd < 0; ++attempt)
+	{
+		fd = open_socket(address, false);
+		if (fd < 0)
+		{
+			usleep(100 * 1000);
+		}
+	}
+	if (fd < 0)
+	{
+		cout << "Worker couldn't connect to " << address << endl;
+		return 1;
+	}
+
+	std::vector<uint8_t> message;
+	while (recv_message(fd, message))
+	{
+		MessageReader in(message.data(), message.size());
+		if (in.u8() != MSG_TILE)
+		{
+			break;
+		}
+
+		const uint32_t tile = in.u32();
+		const int y0 = (int) in.u32();
+		const int y1 = (int) in.u32();
+		const int width = (int) in.u32();
+		const int height = (int) in.u32();
+		const int maxIterations = (int) in.u32();
+		RenderSettings settings;
+		settings.view.left = in.f64();
+		settings.view.right = in.f64();
+		settings.view.top = in.f64();
+		settings.view.bottom = in.f64();
+		settings.fractal.julia = in.u8() != 0;
+		settings.fractal.cRe = in.f64();
+		settings.fractal.cIm = in.f64();
+		settings.kernel = find_kernel(in.str());
+		settings.threads = threads;
+		settings.scheduler = Scheduler::Dynamic;
+		if (!in.ok() || settings.kernel == nullptr || y0 < 0 || y1 > height || y0 >= y1 || width <= 0)
+		{
+			cout << "Worker got a bad tile request" << endl;
+			break;
+		}
+
+		Frame frame(width, height, maxIterations, y0, y1 - y0);
+		render_rows(settings, frame, y0, y1);
+
+		MessageWriter out;
+		out.u8(MSG_RESULT);
+		out.u32(tile);
+		out.u32(y0);
+		out.u32(y1);
+		compress_rows(frame, y0, y1, out);
+		if (!send_all(fd, out.framed()))
+		{
+			break;
+		}
+	}
+
+	close(fd);
+	return 0;
+}
+
+// A connected worker, from the coordinator's point of view.
+struct Connection
+{
+	int fd;
+	std::vector<uint8_t> input;
+
+	// The tile it's working on, or -1 if it's idle.
+	int tile = -1;
+	the_clock::time_point started;
+};
+
+struct TileState
+{
+	int y0, y1;
+	bool done = false;
+
+	// How many workers are currently rendering this tile.
+	int assigned = 0;
+	the_clock::time_point firstAssigned;
+};
+
+void render_distributed(const RenderSettings &settings, Frame &frame, const string &address, int spawnWorkers, double tileTimeout)
+{
+	int listener = open_socket(address, true);
+	if (listener < 0)
+	{
+		cout << "Couldn't listen on " << address << endl;
+		exit(1);
+	}
+
+	// Local workers are forked copies of this process. They're removed from
+	// here as they exit.
+	std::vector<pid_t> children;
+	for (int i = 0; i < spawnWorkers; ++i)
+	{
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			close(listener);
+			_exit(run_worker(address, settings.threads));
+		}
+		else if (pid > 0)
+		{
+			children.push_back(pid);
+		}
+	}
+	if (spawnWorkers == 0)
+	{
+		cout << "Waiting for workers on " << address << endl;
+	}
+
+	std::vector<TileState> tiles;
+	for (int y = 0; y < frame.height; y += TILE_ROWS)
+	{
+		TileState tile;
+		tile.y0 = y;
+		tile.y1 = std::min(y + TILE_ROWS, frame.height);
+		tiles.push_back(tile);
+	}
+
+	std::vector<Connection> connections;
+	size_t nextTile = 0;
+	size_t tilesDone = 0;
+	double totalTileTime = 0.0;
+	int reassigned = 0;
+
+	// When we last had a worker, or one of our own still starting up.
+	the_clock::time_point lastWorker = the_clock::now();
+
+	auto send_tile = [&](Connection &conn, int index) {
+		TileState &tile = tiles[index];
+		MessageWriter out;
+		out.u8(MSG_TILE);
+		out.u32(index);
+		out.u32(tile.y0);
+		out.u32(tile.y1);
+		out.u32(frame.width);
+		out.u32(frame.height);
+		out.u32(frame.maxIterations);
+		out.f64(settings.view.left);
+		out.f64(settings.view.right);
+		out.f64(settings.view.top);
+		out.f64(settings.view.bottom);
+		out.u8(settings.fractal.julia ? 1 : 0);
+		out.f64(settings.fractal.cRe);
+		out.f64(settings.fractal.cIm);
+		out.str(settings.kernel->name);
+
+		conn.tile = index;
+		conn.started = the_clock::now();
+		if (tile.assigned == 0)
+		{
+			tile.firstAssigned = conn.started;
+		}
+		++tile.assigned;
+		// If this fails, we'll notice when we next poll the connection.
+		send_all(conn.fd, out.framed());
+	};
+
+	auto drop = [&](size_t i) {
+		Connection &conn = connections[i];
+		if (conn.tile >= 0)
+		{
+			// Anything it was doing goes back to being unassigned, so another
+			// worker will pick it up.
+			--tiles[conn.tile].assigned;
+		}
+		close(conn.fd);
+		connections.erase(connections.begin() + i);
+	};
+
+	while (tilesDone < tiles.size())
+	{
+		const the_clock::time_point now = the_clock::now();
+
+		// Reap local workers that have exited, and give up if nobody is left
+		// to do the work: straight away if all our own workers have gone,
+		// or after a while if we're waiting for workers to connect.
+		// Only our own children: anything else this process has started
+		// isn't ours to reap.
+		children.erase(std::remove_if(children.begin(), children.end(), [](pid_t pid) {
+			pid_t result;
+			do
+			{
+				result = waitpid(pid, nullptr, WNOHANG);
+			} while (result < 0 && errno == EINTR);
+			return result != 0;
+		}), children.end());
+		if (!connections.empty() || !children.empty())
+		{
+			lastWorker = now;
+		}
+		else if (spawnWorkers > 0 || duration<double>(now - lastWorker).count() > WORKER_WAIT_SECONDS)
+		{
+			cout << "No workers are left to render the remaining " << tiles.size() - tilesDone << " tile(s)." << endl;
+			close(listener);
+			if (address.compare(0, 5, "unix:") == 0)
+			{
+				unlink(address.substr(5).c_str());
+			}
+			exit(1);
+		}
+
+		// How long a tile can take before we try it somewhere else.
+		double timeout = tileTimeout;
+		if (timeout <= 0.0)
+		{
+			timeout = tilesDone == 0 ? 30.0 : std::max(1.0, 4.0 * totalTileTime / tilesDone);
+		}
+
+		for (Connection &conn : connections)
+		{
+			if (conn.tile >= 0)
+			{
+				continue;
+			}
+
+			// First anything that nobody's working on (including tiles from
+			// workers that have gone away), then new tiles, then steal a
+			// slow tile from another worker.
+			int choice = -1;
+			for (size_t i = 0; i < nextTile && choice < 0; ++i)
+			{
+				if (!tiles[i].done && tiles[i].assigned == 0)
+				{
+					choice = (int) i;
+					++reassigned;
+				}
+			}
+			if (choice < 0 && nextTile < tiles.size())
+			{
+				choice = (int) nextTile++;
+			}
+			for (size_t i = 0; i < nextTile && choice < 0; ++i)
+			{
+				if (!tiles[i].done && tiles[i].assigned == 1
+					&& duration<double>(now - tiles[i].firstAssigned).count() > timeout)
+				{
+					choice = (int) i;
+					++reassigned;
+				}
+			}
+
+			if (choice >= 0)
+			{
+				send_tile(conn, choice);
+			}
+		}
+
+		std::vector<pollfd> fds;
+		fds.push_back({ listener, POLLIN, 0 });
+		for (const Connection &conn : connections)
+		{
+			fds.push_back({ conn.fd, POLLIN, 0 });
+		}
+		if (poll(fds.data(), fds.size(), 100) < 0)
+		{
+			continue;
+		}
+
+		if (fds[0].revents & POLLIN)
+		{
+			int fd = accept(listener, nullptr, nullptr);
+			if (fd >= 0)
+			{
+				Connection conn;
+				conn.fd = fd;
+				connections.push_back(conn);
+			}
+		}
+
+		// Go backwards so that dropping a connection doesn't upset the indices.
+		for (size_t i = fds.size() - 1; i >= 1; --i)
+		{
+			if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+			{
+				continue;
+			}
+
+			Connection &conn = connections[i - 1];
+			uint8_t buffer[65536];
+			ssize_t n = recv(conn.fd, buffer, sizeof buffer, 0);
+			if (n <= 0)
+			{
+				drop(i - 1);
+				continue;
+			}
+			conn.input.insert(conn.input.end(), buffer, buffer + n);
+
+			// Handle every complete message we've received.
+			bool bad = false;
+			while (conn.input.size() >= 4)
+			{
+				MessageReader header(conn.input.data(), 4);
+				const size_t size = header.u32();
+				if (size > MAX_MESSAGE_SIZE)
+				{
+					bad = true;
+					break;
+				}
+				if (conn.input.size() < 4 + size)
+				{
+					break;
+				}
+
+				MessageReader in(conn.input.data() + 4, size);
+				const uint8_t type = in.u8();
+				const uint32_t index = in.u32();
+				const int y0 = (int) in.u32();
+				const int y1 = (int) in.u32();
+				if (type != MSG_RESULT || index >= tiles.size() || y0 != tiles[index].y0 || y1 != tiles[index].y1
+					|| (int) index != conn.tile)
+				{
+					bad = true;
+					break;
+				}
+
+				TileState &tile = tiles[index];
+				if (!tile.done)
+				{
+					if (!decompress_rows(in, frame, y0, y1))
+					{
+						bad = true;
+						break;
+					}
+					tile.done = true;
+					++tilesDone;
+					totalTileTime += duration<double>(the_clock::now() - conn.started).count();
+				}
+
+				--tile.assigned;
+				conn.tile = -1;
+				conn.input.erase(conn.input.begin(), conn.input.begin() + 4 + size);
+			}
+
+			if (bad)
+			{
+				cout << "Dropping a worker that sent a bad result" << endl;
+				drop(i - 1);
+			}
+		}
+	}
+
+	// Tell everyone we're finished.
+	MessageWriter quit;
+	quit.u8(MSG_QUIT);
+	for (Connection &conn : connections)
+	{
+		send_all(conn.fd, quit.framed());
+		close(conn.fd);
+	}
+	close(listener);
+	if (address.compare(0, 5, "unix:") == 0)
+	{
+		unlink(address.substr(5).c_str());
+	}
+
+	for (pid_t pid : children)
+	{
+		waitpid(pid, nullptr, 0);
+	}
+
+	if (reassigned > 0)
+	{
+		cout << reassigned << " tile(s) were reassigned from slow or lost workers." << endl;
+	}
+}
+
+#endif
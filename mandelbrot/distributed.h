@@ -0,0 +1,33 @@
+// Rendering across several processes over sockets
+// A coordinator splits the frame into tiles of TILE_ROWS rows and hands them
+// out to worker processes, which may be on other machines. Workers send back
+// run-length compressed iteration counts. Tiles held by a worker that
+// disconnects are handed to someone else; tiles that are taking much longer
+// than usual are also given to an idle worker, and whichever copy finishes
+// first is used. If every worker goes away (or, with no local workers, none
+// connects for WORKER_WAIT_SECONDS), the render fails.
+//
+// Addresses are "unix:/path/to/socket" for a Unix-domain socket, or
+// "host:port" for TCP.
+
+#pragma once
+
+#include <string>
+
+#include "render.h"
+#include "scheduler.h"
+
+// How long the coordinator waits with no workers at all, when it didn't
+// start any of its own, before giving up.
+const double WORKER_WAIT_SECONDS = 60.0;
+
+// Listen on address and render the frame using whichever workers connect.
+// If spawnWorkers > 0, that many local worker processes are started too.
+// A tile is given to a second worker if it has been outstanding for more
+// than tileTimeout seconds; 0 means work it out from the tiles so far.
+void render_distributed(const RenderSettings &settings, Frame &frame, const std::string &address, int spawnWorkers, double tileTimeout);
+
+// Connect to a coordinator and render tiles until it has no more.
+// Each tile is rendered with the given number of threads.
+// Returns the process exit status.
+int run_worker(const std::string &address, int threads);
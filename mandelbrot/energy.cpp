@@ -0,0 +1,72 @@
+// Measuring the energy used by a render
+
+#include "energy.h"
+
+#include <filesystem>
+#include <fstream>
+
+using std::string;
+
+// Read a single number from a sysfs file. Returns false if it can't.
+static bool read_number(const string &path, uint64_t &value)
+{
+	std::ifstream in(path);
+	return (bool) (in >> value);
+}
+
+EnergyMeter::EnergyMeter(const string &root)
+{
+#ifdef __linux__
+	// Packages are "intel-rapl:N"; their subzones (cores, DRAM) are
+	// "intel-rapl:N:M" and are already included in the package total.
+	// AMD CPUs use the same driver and names.
+	std::error_code error;
+	for (const auto &entry : std::filesystem::directory_iterator(root, error))
+	{
+		const string name = entry.path().filename().string();
+		if (name.compare(0, 11, "intel-rapl:") != 0 || name.find(':', 11) != string::npos)
+		{
+			continue;
+		}
+
+		Counter counter;
+		counter.path = (entry.path() / "energy_uj").string();
+		uint64_t value;
+		if (!read_number(counter.path, value) || !read_number((entry.path() / "max_energy_range_uj").string(), counter.range))
+		{
+			continue;
+		}
+		counters.push_back(counter);
+	}
+#else
+	(void) root;
+#endif
+}
+
+EnergyReading EnergyMeter::read() const
+{
+	EnergyReading reading;
+	for (const Counter &counter : counters)
+	{
+		uint64_t value = 0;
+		read_number(counter.path, value);
+		reading.push_back(value);
+	}
+	return reading;
+}
+
+double EnergyMeter::joules(const EnergyReading &start, const EnergyReading &end) const
+{
+	if (counters.empty())
+	{
+		return -1.0;
+	}
+
+	uint64_t total = 0;
+	for (size_t i = 0; i < counters.size() && i < start.size() && i < end.size(); ++i)
+	{
+		// Allow for the counter having wrapped once.
+		total += end[i] >= start[i] ? end[i] - start[i] : counters[i].range - start[i] + end[i] + 1;
+	}
+	return total / 1e6;
+}
@@ -0,0 +1,38 @@
+// Measuring the energy used by a render
+// On Linux, Intel and AMD CPUs report the energy used by each package through
+// the RAPL counters in /sys/class/powercap. Elsewhere, or if the counters
+// can't be read (they're often only readable by root), nothing is measured.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The counters at one moment, in microjoules.
+typedef std::vector<uint64_t> EnergyReading;
+
+class EnergyMeter
+{
+public:
+	// Find the package-level counters under root.
+	explicit EnergyMeter(const std::string &root = "/sys/class/powercap");
+
+	bool available() const { return !counters.empty(); }
+
+	EnergyReading read() const;
+
+	// The joules used by all the packages between two readings, or -1 if
+	// there are no counters.
+	double joules(const EnergyReading &start, const EnergyReading &end) const;
+
+private:
+	struct Counter
+	{
+		std::string path;
+
+		// The counter wraps back to 0 after this many microjoules.
+		uint64_t range;
+	};
+	std::vector<Counter> counters;
+};
@@ -0,0 +1,395 @@
+// Checking kernels against golden iteration buffers
+
+#include "golden.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "deepen.h"
+#include "distance.h"
+#include "distributed.h"
+#include "kernels.h"
+#include "pipeline.h"
+#include "render.h"
+#include "scheduler.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+// One of the standard views the kernels are checked on.
+struct GoldenView
+{
+	const char *name;
+	View view;
+	int width, height, maxIterations;
+	Fractal fractal;
+};
+
+// Small enough that the reference kernel is quick; the odd sizes catch
+// kernels that assume the width is a multiple of their batch size.
+static const GoldenView GOLDEN_VIEWS[] = {
+	{ "whole", WHOLE_SET, 480, 256, MAX_ITERATIONS },
+	{ "zoom", ZOOMED, 481, 257, MAX_ITERATIONS },
+	{ "seahorse", { -0.7436447860, -0.7436347860, 0.1318305, 0.1318255 }, 320, 160, 2000 },
+	{ "julia", JULIA_SET, 481, 271, MAX_ITERATIONS, { true, -0.8, 0.156 } },
+	{ "rabbit", JULIA_SET, 480, 256, MAX_ITERATIONS, { true, -0.123, 0.745 } },
+};
+
+static const char GOLDEN_MAGIC[8] = { 'M', 'B', 'G', 'O', 'L', 'D', '2', '\n' };
+
+static string golden_path(const string &dir, const GoldenView &gv)
+{
+	return dir + "/" + gv.name + ".golden";
+}
+
+static void save_frame(const string &path, const GoldenView &gv, const Frame &frame)
+{
+	std::ofstream out(path, std::ofstream::binary);
+	out.write(GOLDEN_MAGIC, sizeof GOLDEN_MAGIC);
+	const int32_t sizes[3] = { gv.width, gv.height, gv.maxIterations };
+	out.write((const char *) sizes, sizeof sizes);
+	out.write((const char *) &gv.view, sizeof gv.view);
+	const double julia[3] = { gv.fractal.julia ? 1.0 : 0.0, gv.fractal.cRe, gv.fractal.cIm };
+	out.write((const char *) julia, sizeof julia);
+	out.write((const char *) frame.iterations.data(), frame.iterations.size() * sizeof(int));
+
+	out.close();
+	if (!out)
+	{
+		cout << "Error writing to " << path << endl;
+		exit(1);
+	}
+}
+
+// Load a golden buffer. Returns false if the file doesn't exist; exits if
+// it's for a different view from the one we expect.
+static bool load_frame(const string &path, const GoldenView &gv, Frame &frame)
+{
+	std::ifstream in(path, std::ifstream::binary);
+	if (!in)
+	{
+		return false;
+	}
+
+	char magic[sizeof GOLDEN_MAGIC];
+	int32_t sizes[3];
+	View view;
+	double julia[3];
+	in.read(magic, sizeof magic);
+	in.read((char *) sizes, sizeof sizes);
+	in.read((char *) &view, sizeof view);
+	in.read((char *) julia, sizeof julia);
+	if (!in || memcmp(magic, GOLDEN_MAGIC, sizeof magic) != 0
+		|| sizes[0] != gv.width || sizes[1] != gv.height || sizes[2] != gv.maxIterations
+		|| memcmp(&view, &gv.view, sizeof view) != 0
+		|| (julia[0] != 0.0) != gv.fractal.julia || julia[1] != gv.fractal.cRe || julia[2] != gv.fractal.cIm)
+	{
+		cout << path << " doesn't match the current standard views; rerun with --golden to regenerate it." << endl;
+		exit(1);
+	}
+
+	in.read((char *) frame.iterations.data(), frame.iterations.size() * sizeof(int));
+	if (!in)
+	{
+		cout << "Error reading " << path << endl;
+		exit(1);
+	}
+	return true;
+}
+
+static void render_reference(const GoldenView &gv, Frame &frame)
+{
+	compute_mandelbrot(all_kernels()[0], gv.view, frame, 0, frame.height, gv.fractal);
+}
+
+void write_golden(const string &dir)
+{
+	std::filesystem::create_directories(dir);
+	for (const GoldenView &gv : GOLDEN_VIEWS)
+	{
+		Frame frame(gv.width, gv.height, gv.maxIterations);
+		render_reference(gv, frame);
+		save_frame(golden_path(dir, gv), gv, frame);
+		cout << "Wrote " << golden_path(dir, gv) << endl;
+	}
+}
+
+// Write an image showing where two renders differ: matching pixels in dim
+// grey, mismatches in red (too few iterations) or green (too many).
+static void write_diff(const string &path, const Frame &golden, const Frame &actual)
+{
+	Frame diff(golden.width, golden.height, golden.maxIterations);
+	for (size_t i = 0; i < diff.image.size(); ++i)
+	{
+		if (actual.iterations[i] < golden.iterations[i])
+		{
+			diff.image[i] = 0xFF0000;
+		}
+		else if (actual.iterations[i] > golden.iterations[i])
+		{
+			diff.image[i] = 0x00FF00;
+		}
+		else
+		{
+			uint32_t grey = 0x20 + (0x40 * golden.iterations[i]) / golden.maxIterations;
+			diff.image[i] = (grey << 16) | (grey << 8) | grey;
+		}
+	}
+	write_tga(diff, path.c_str());
+}
+
+// Where the coordinator runs listen while they're being checked.
+static string verify_socket()
+{
+#ifdef _WIN32
+	return "";
+#else
+	return "unix:" + (std::filesystem::temp_directory_path() / ("mandelbrot-verify-" + std::to_string(getpid()) + ".sock")).string();
+#endif
+}
+
+int verify_kernels(const string &dir, double tolerance)
+{
+	int failures = 0;
+
+	for (const GoldenView &gv : GOLDEN_VIEWS)
+	{
+		// A golden buffer made now would come from the same build it's
+		// checking, so a missing one is a failure rather than something to
+		// fill in.
+		Frame golden(gv.width, gv.height, gv.maxIterations);
+		if (!load_frame(golden_path(dir, gv), gv, golden))
+		{
+			cout << "FAIL " << gv.name << ": " << golden_path(dir, gv) << " is missing; write it with --golden from a build you trust." << endl;
+			++failures;
+			continue;
+		}
+
+		for (const Kernel &kernel : all_kernels())
+		{
+			// Each kernel on its own, and split up by each scheduler, which
+			// mustn't change the results. The last run hands the tiles to
+			// three local worker processes over a Unix socket, which checks
+			// the wire format as well.
+			struct { int threads; Scheduler scheduler; bool distributed; } runs[] = {
+				{ 1, Scheduler::Static, false },
+				{ 3, Scheduler::Static, false },
+				{ 3, Scheduler::Dynamic, false },
+#ifndef _WIN32
+				{ 3, Scheduler::Process, false },
+				{ 1, Scheduler::Dynamic, true },
+#endif
+			};
+
+			for (const auto &run : runs)
+			{
+				RenderSettings settings;
+				settings.view = gv.view;
+				settings.fractal = gv.fractal;
+				settings.kernel = &kernel;
+				settings.threads = run.threads;
+				settings.scheduler = run.scheduler;
+
+				Frame actual(gv.width, gv.height, gv.maxIterations);
+				if (run.distributed)
+				{
+					render_distributed(settings, actual, verify_socket(), 3, 0.0);
+				}
+				else
+				{
+					render_frame(settings, actual);
+				}
+				const string schedulerName = run.distributed ? "coordinator" : scheduler_name(run.scheduler);
+
+				long long mismatches = 0;
+				for (size_t i = 0; i < golden.iterations.size(); ++i)
+				{
+					if (actual.iterations[i] != golden.iterations[i])
+					{
+						++mismatches;
+					}
+				}
+				const double rate = (double) mismatches / golden.iterations.size();
+				const bool ok = kernel.exact ? mismatches == 0 : rate <= tolerance;
+
+				string label = string(gv.name) + "/" + kernel.name + "/" + schedulerName + "/threads:" + std::to_string(run.threads);
+				cout << (ok ? "ok   " : "FAIL ") << label << ": " << mismatches << " pixels differ ("
+					<< rate * 100.0 << "%, " << (kernel.exact ? "must be exact" : "approximate") << ")" << endl;
+
+				if (mismatches > 0)
+				{
+					string path = dir + "/diff_" + gv.name + "_" + kernel.name + "_" + schedulerName + "_" + std::to_string(run.threads) + ".tga";
+					write_diff(path, golden, actual);
+				}
+				if (!ok)
+				{
+					++failures;
+				}
+			}
+		}
+
+		// All the interior kernel ever gets wrong is whether a point is in
+		// the set, so whatever the tolerance, it mustn't put a single pixel
+		// on the wrong side of the edge of the set.
+		{
+			RenderSettings settings;
+			settings.view = gv.view;
+			settings.fractal = gv.fractal;
+			settings.kernel = find_kernel("interior");
+			settings.threads = 3;
+			settings.scheduler = Scheduler::Dynamic;
+
+			Frame actual(gv.width, gv.height, gv.maxIterations);
+			render_frame(settings, actual);
+
+			long long mismatches = 0;
+			for (size_t i = 0; i < golden.iterations.size(); ++i)
+			{
+				if ((actual.iterations[i] == gv.maxIterations) != (golden.iterations[i] == gv.maxIterations))
+				{
+					++mismatches;
+				}
+			}
+
+			string label = string(gv.name) + "/interior_classification/threads:3";
+			cout << (mismatches == 0 ? "ok   " : "FAIL ") << label << ": " << mismatches << " pixels in or out of the set wrongly (must be exact)" << endl;
+			if (mismatches > 0)
+			{
+				write_diff(dir + "/diff_" + gv.name + "_interior_classification.tga", golden, actual);
+				++failures;
+			}
+		}
+
+		// Rendering through the coroutine pipeline must write the same file
+		// as the streamed pipeline. Tiles reach the file in whatever order
+		// they finish, handing the AsyncMutex around, so a lost or doubled
+		// hand-off shows up as missing or misplaced rows.
+		{
+			RenderSettings settings;
+			settings.view = gv.view;
+			settings.fractal = gv.fractal;
+			settings.kernel = &all_kernels()[0];
+			settings.threads = 3;
+			settings.scheduler = Scheduler::Dynamic;
+
+			Frame streamed(gv.width, gv.height, gv.maxIterations);
+			std::vector<uint8_t> expected(tga_size(streamed));
+			render_streaming(settings, streamed, [&](int yPosSt, int yPosEnd) {
+				colour_mandelbrot(streamed, yPosSt, yPosEnd);
+				encode_tga_rows(streamed, expected.data(), yPosSt, yPosEnd);
+			});
+
+			const std::filesystem::path path = std::filesystem::temp_directory_path() / ("mandelbrot-verify-" + string(gv.name) + ".tga");
+			Frame actual(gv.width, gv.height, gv.maxIterations);
+			render_coroutines(settings, actual, path.string().c_str());
+
+			std::ifstream in(path, std::ifstream::binary);
+			std::vector<uint8_t> written((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+			in.close();
+			std::filesystem::remove(path);
+
+			long long mismatches = 0;
+			for (size_t i = 0; i < std::min(written.size(), expected.size()); ++i)
+			{
+				if (written[i] != expected[i])
+				{
+					++mismatches;
+				}
+			}
+			const bool ok = written.size() == expected.size() && mismatches == 0;
+
+			string label = string(gv.name) + "/coroutines/threads:3";
+			cout << (ok ? "ok   " : "FAIL ") << label << ": " << mismatches << " bytes differ from the streamed image";
+			if (written.size() != expected.size())
+			{
+				cout << ", and it's " << written.size() << " bytes rather than " << expected.size();
+			}
+			cout << " (must be exact)" << endl;
+			if (!ok)
+			{
+				write_diff(dir + "/diff_" + gv.name + "_coroutines.tga", streamed, actual);
+				++failures;
+			}
+		}
+
+		// The distance kernels and deepening only do the Mandelbrot set.
+		if (gv.fractal.julia)
+		{
+			continue;
+		}
+
+		// The distance kernels must get the same iteration counts as the
+		// golden buffers; their distances are only estimates.
+		for (const DistanceKernel &kernel : all_distance_kernels())
+		{
+			RenderSettings settings;
+			settings.view = gv.view;
+			settings.kernel = &all_kernels()[0];
+			settings.threads = 3;
+			settings.scheduler = Scheduler::Dynamic;
+
+			Frame actual(gv.width, gv.height, gv.maxIterations);
+			std::vector<double> distance;
+			render_distance(kernel, settings, actual, distance);
+
+			long long mismatches = 0;
+			for (size_t i = 0; i < golden.iterations.size(); ++i)
+			{
+				if (actual.iterations[i] != golden.iterations[i])
+				{
+					++mismatches;
+				}
+			}
+
+			string label = string(gv.name) + "/distance_" + kernel.name + "/threads:3";
+			cout << (mismatches == 0 ? "ok   " : "FAIL ") << label << ": " << mismatches << " pixels differ (must be exact)" << endl;
+			if (mismatches > 0)
+			{
+				write_diff(dir + "/diff_" + gv.name + "_distance_" + kernel.name + ".tga", golden, actual);
+				++failures;
+			}
+		}
+
+		// Deepening a render from a quarter of the iterations, in two steps,
+		// must give the same result as rendering with them all.
+		{
+			Frame actual(gv.width, gv.height, gv.maxIterations / 4);
+			SavedOrbits orbits;
+			render_saving_orbits(gv.view, actual, 3, orbits);
+			deepen_frame(actual, gv.maxIterations / 2, 3, orbits);
+			deepen_frame(actual, gv.maxIterations, 3, orbits);
+
+			long long mismatches = 0;
+			for (size_t i = 0; i < golden.iterations.size(); ++i)
+			{
+				if (actual.iterations[i] != golden.iterations[i])
+				{
+					++mismatches;
+				}
+			}
+
+			string label = string(gv.name) + "/deepen/threads:3";
+			cout << (mismatches == 0 ? "ok   " : "FAIL ") << label << ": " << mismatches << " pixels differ (must be exact)" << endl;
+			if (mismatches > 0)
+			{
+				write_diff(dir + "/diff_" + gv.name + "_deepen.tga", golden, actual);
+				++failures;
+			}
+		}
+	}
+
+	cout << (failures == 0 ? "All kernels match the golden buffers." : "Some kernels don't match the golden buffers.") << endl;
+	return failures;
+}
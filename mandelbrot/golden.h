@@ -0,0 +1,22 @@
+// Checking kernels against golden iteration buffers
+// The reference kernel renders a set of standard views once, and the
+// iteration counts are stored (the ones in golden/ are checked in). Every
+// other kernel (and scheduler) is then checked against them.
+
+#pragma once
+
+#include <string>
+
+// The largest fraction of pixels an approximate kernel may get wrong.
+const double DEFAULT_MISMATCH_TOLERANCE = 0.01;
+
+// Render the standard views with the reference kernel and store the
+// iteration buffers in the given directory.
+void write_golden(const std::string &dir);
+
+// Check every kernel against the golden buffers in dir; a missing buffer
+// counts as a failure. Kernels that are marked exact must match exactly;
+// others may differ in up to "tolerance" of the pixels. A diff image is
+// written into dir for each mismatching render.
+// Returns the number of failures.
+int verify_kernels(const std::string &dir, double tolerance);
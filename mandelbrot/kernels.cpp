@@ -0,0 +1,740 @@
+// Escape-time kernels
+
+#include "kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KERNELS_SSE2
+#endif
+
+using std::complex;
+
+// Where each point's orbit starts. The kernels below are written once, in
+// terms of one of these, and used for both the Mandelbrot set and Julia sets.
+
+// The Mandelbrot set: z starts at 0, and c is the point.
+struct MandelbrotStart
+{
+	void operator()(double re, double im, double &x, double &y, double &cr, double &ci) const
+	{
+		x = 0.0;
+		y = 0.0;
+		cr = re;
+		ci = im;
+	}
+
+	// Can we tell without iterating that the point is in the set?
+	bool known_inside(double re, double im) const
+	{
+		return in_cardioid_or_bulb(re, im);
+	}
+};
+
+// A Julia set: z starts at the point, and c is fixed.
+struct JuliaStart
+{
+	double cRe, cIm;
+
+	void operator()(double re, double im, double &x, double &y, double &cr, double &ci) const
+	{
+		x = re;
+		y = im;
+		cr = cRe;
+		ci = cIm;
+	}
+
+	bool known_inside(double, double) const
+	{
+		return false;
+	}
+};
+
+template <typename Start>
+static void reference_core(const Start &start, const double *re, const double *im, int count, int maxIterations, int *iterations)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		double x, y, cr, ci;
+		start(re[i], im[i], x, y, cr, ci);
+		complex<double> c(cr, ci);
+
+		// Start off z at (0, 0), or the point for a Julia set.
+		complex<double> z(x, y);
+
+		// Iterate z = z^2 + c until z moves more than 2 units
+		// away from (0, 0), or we've iterated too many times.
+		int n = 0;
+
+		// % cost before optimization - ~84.41%
+
+		// Original @ ~84.41%
+		//while (abs(z) < 2.0 && n < maxIterations) // abs(z) = sqrt(z^2) = (abs(z))^2 = z^2
+		//{
+		//	z = (z * z) + c;
+
+		//	++n;
+		//}
+
+		// % cost after optimization - ~71.07%
+
+		// Optimized @ ~
+		while (std::norm(z) < 4.0 && n < maxIterations) // abs(z) = sqrt(z^2) = (abs(z))^2 = z^2		std::norm - rtns the magnitude squared of a complex number.
+		{
+			z = (z * z) + c;
+
+			++n;
+		}
+
+		iterations[i] = n;
+	}
+}
+
+void kernel_reference(const double *re, const double *im, int count, int maxIterations, int *iterations)
+{
+	reference_core(MandelbrotStart(), re, im, count, maxIterations, iterations);
+}
+
+void kernel_julia_reference(const double *re, const double *im, int count, double cRe, double cIm, int maxIterations, int *iterations)
+{
+	reference_core(JuliaStart{ cRe, cIm }, re, im, count, maxIterations, iterations);
+}
+
+template <typename Start>
+static void scalar_core(const Start &start, const double *re, const double *im, int count, int maxIterations, int *iterations)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		// z = x + yi, and its squared parts.
+		double x, y, cr, ci;
+		start(re[i], im[i], x, y, cr, ci);
+		double x2 = x * x, y2 = y * y;
+
+		// std::complex computes z * z as (x*x - y*y) + (x*y + y*x)i, with a
+		// call out to handle NaNs and infinities that we never hit. Doing the
+		// same operations in the same order gives exactly the same results.
+		int n = 0;
+		while (x2 + y2 < 4.0 && n < maxIterations)
+		{
+			const double xy = x * y;
+			y = (xy + xy) + ci;
+			x = (x2 - y2) + cr;
+			x2 = x * x;
+			y2 = y * y;
+
+			++n;
+		}
+
+		iterations[i] = n;
+	}
+}
+
+void kernel_scalar(const double *re, const double *im, int count, int maxIterations, int *iterations)
+{
+	scalar_core(MandelbrotStart(), re, im, count, maxIterations, iterations);
+}
+
+void kernel_julia_scalar(const double *re, const double *im, int count, double cRe, double cIm, int maxIterations, int *iterations)
+{
+	scalar_core(JuliaStart{ cRe, cIm }, re, im, count, maxIterations, iterations);
+}
+
+// The number of pixels kernel_chains works on at once.
+const int CHAINS = 8;
+
+template <typename Start>
+static void chains_core(const Start &startPoint, const double *re, const double *im, int count, int maxIterations, int *iterations)
+{
+	// The state of each chain, as in kernel_scalar. pixel is the index of
+	// the point it's working on, or -1 once we've run out of points.
+	double cr[CHAINS], ci[CHAINS];
+	double x[CHAINS], y[CHAINS];
+	double x2[CHAINS], y2[CHAINS];
+	int n[CHAINS], pixel[CHAINS];
+
+	int next = 0;
+	int active = 0;
+
+	// Start a chain off on the next point, if there is one.
+	auto start = [&](int c) {
+		if (next < count)
+		{
+			pixel[c] = next;
+			startPoint(re[next], im[next], x[c], y[c], cr[c], ci[c]);
+			x2[c] = x[c] * x[c];
+			y2[c] = y[c] * y[c];
+			n[c] = 0;
+			++next;
+			++active;
+		}
+		else
+		{
+			pixel[c] = -1;
+		}
+	};
+
+	for (int c = 0; c < CHAINS; ++c)
+	{
+		start(c);
+	}
+
+	// Each step advances every chain by one iteration. The chains don't
+	// depend on each other, so the CPU can overlap their multiplies rather
+	// than waiting for each one in turn. When a point escapes, its chain
+	// picks up the next point straight away.
+	while (active > 0)
+	{
+		for (int c = 0; c < CHAINS; ++c)
+		{
+			if (pixel[c] < 0)
+			{
+				continue;
+			}
+
+			if (x2[c] + y2[c] < 4.0 && n[c] < maxIterations)
+			{
+				const double xy = x[c] * y[c];
+				y[c] = (xy + xy) + ci[c];
+				x[c] = (x2[c] - y2[c]) + cr[c];
+				x2[c] = x[c] * x[c];
+				y2[c] = y[c] * y[c];
+
+				++n[c];
+			}
+			else
+			{
+				iterations[pixel[c]] = n[c];
+				--active;
+				start(c);
+			}
+		}
+	}
+}
+
+void kernel_chains(const double *re, const double *im, int count, int maxIterations, int *iterations)
+{
+	chains_core(MandelbrotStart(), re, im, count, maxIterations, iterations);
+}
+
+void kernel_julia_chains(const double *re, const double *im, int count, double cRe, double cIm, int maxIterations, int *iterations)
+{
+	chains_core(JuliaStart{ cRe, cIm }, re, im, count, maxIterations, iterations);
+}
+
+// The number of points kernel_float iterates in lockstep.
+const int FLOAT_LANES = 8;
+
+#ifdef KERNELS_SSE2
+
+// Four of kernel_float's lanes in one set of SSE registers.
+struct FloatLanes
+{
+	__m128 cr, ci;
+	__m128 x, y;
+	__m128 x2, y2;
+	__m128i n;
+
+	void start(const float *zr, const float *zi, const float *re, const float *im)
+	{
+		cr = _mm_loadu_ps(re);
+		ci = _mm_loadu_ps(im);
+		x = _mm_loadu_ps(zr);
+		y = _mm_loadu_ps(zi);
+		x2 = _mm_mul_ps(x, x);
+		y2 = _mm_mul_ps(y, y);
+		n = _mm_setzero_si128();
+	}
+
+	// Do one iteration for the lanes that haven't escaped yet. Returns a
+	// mask of those lanes.
+	__m128 step()
+	{
+		const __m128 inside = _mm_cmplt_ps(_mm_add_ps(x2, y2), _mm_set1_ps(4.0f));
+		const __m128 xy = _mm_mul_ps(x, y);
+		const __m128 nextY = _mm_add_ps(_mm_add_ps(xy, xy), ci);
+		const __m128 nextX = _mm_add_ps(_mm_sub_ps(x2, y2), cr);
+		x = _mm_or_ps(_mm_and_ps(inside, nextX), _mm_andnot_ps(inside, x));
+		y = _mm_or_ps(_mm_and_ps(inside, nextY), _mm_andnot_ps(inside, y));
+		x2 = _mm_mul_ps(x, x);
+		y2 = _mm_mul_ps(y, y);
+
+		// The mask is all ones (-1) in the lanes that are inside.
+		n = _mm_sub_epi32(n, _mm_castps_si128(inside));
+		return inside;
+	}
+};
+
+#endif
+
+template <typename Start>
+static void float_core(const Start &start, const double *re, const double *im, int count, int maxIterations, int *iterations)
+{
+	for (int base = 0; base < count; base += FLOAT_LANES)
+	{
+		// Spare lanes past the end of the batch get a point that escapes at once.
+		float x[FLOAT_LANES], y[FLOAT_LANES];
+		float cr[FLOAT_LANES], ci[FLOAT_LANES];
+		for (int l = 0; l < FLOAT_LANES; ++l)
+		{
+			const bool used = base + l < count;
+			double zr, zi, r, i;
+			start(used ? re[base + l] : 4.0, used ? im[base + l] : 0.0, zr, zi, r, i);
+			x[l] = (float) zr;
+			y[l] = (float) zi;
+			cr[l] = (float) r;
+			ci[l] = (float) i;
+		}
+
+		int n[FLOAT_LANES] = {};
+
+#ifdef KERNELS_SSE2
+		FloatLanes a, b;
+		a.start(x, y, cr, ci);
+		b.start(x + 4, y + 4, cr + 4, ci + 4);
+		for (int step = 0; step < maxIterations; ++step)
+		{
+			const __m128 inside = _mm_or_ps(a.step(), b.step());
+			if (_mm_movemask_ps(inside) == 0)
+			{
+				break;
+			}
+		}
+		_mm_storeu_si128((__m128i *) n, a.n);
+		_mm_storeu_si128((__m128i *) (n + 4), b.n);
+#else
+		// The same thing one lane at a time. Lanes that have escaped keep
+		// their state and stop counting.
+		float x2[FLOAT_LANES], y2[FLOAT_LANES];
+		for (int l = 0; l < FLOAT_LANES; ++l)
+		{
+			x2[l] = x[l] * x[l];
+			y2[l] = y[l] * y[l];
+		}
+		for (int step = 0; step < maxIterations; ++step)
+		{
+			bool running = false;
+			for (int l = 0; l < FLOAT_LANES; ++l)
+			{
+				const bool inside = x2[l] + y2[l] < 4.0f;
+				if (inside)
+				{
+					const float xy = x[l] * y[l];
+					y[l] = (xy + xy) + ci[l];
+					x[l] = (x2[l] - y2[l]) + cr[l];
+					x2[l] = x[l] * x[l];
+					y2[l] = y[l] * y[l];
+					++n[l];
+					running = true;
+				}
+			}
+
+			if (!running)
+			{
+				break;
+			}
+		}
+#endif
+
+		for (int l = 0; l < FLOAT_LANES && base + l < count; ++l)
+		{
+			iterations[base + l] = n[l];
+		}
+	}
+}
+
+void kernel_float(const double *re, const double *im, int count, int maxIterations, int *iterations)
+{
+	float_core(MandelbrotStart(), re, im, count, maxIterations, iterations);
+}
+
+void kernel_julia_float(const double *re, const double *im, int count, double cRe, double cIm, int maxIterations, int *iterations)
+{
+	float_core(JuliaStart{ cRe, cIm }, re, im, count, maxIterations, iterations);
+}
+
+// How close together, relative to the spacing of the points, two float
+// coordinates may be before we stop trusting the float kernel at all.
+const double FLOAT_MIN_PITCH = 64.0;
+
+template <typename Start>
+static void hybrid_core(const Start &start, const double *re, const double *im, int count, int maxIterations, int *iterations)
+{
+	// If floats can't tell neighbouring points apart, the float render is
+	// meaningless, so just do the whole batch in double.
+	// (The points may all be in one row, so we can only see the spacing
+	// along it, and assume it's about the same in the other direction.)
+	double pitch = 0.0;
+	for (int i = 1; i < count; ++i)
+	{
+		pitch = std::max(pitch, std::abs(re[i] - re[i - 1]));
+		pitch = std::max(pitch, std::abs(im[i] - im[i - 1]));
+	}
+	double largest = 0.0;
+	for (int i = 0; i < count; ++i)
+	{
+		largest = std::max(largest, std::max(std::abs(re[i]), std::abs(im[i])));
+	}
+	if (count < 2 || pitch < FLOAT_MIN_PITCH * largest * std::numeric_limits<float>::epsilon())
+	{
+		chains_core(start, re, im, count, maxIterations, iterations);
+		return;
+	}
+
+	float_core(start, re, im, count, maxIterations, iterations);
+
+	// The float result can't be trusted near the edge of the set, where a
+	// small error changes how long a point takes to escape. Points whose
+	// neighbours took a different number of iterations are near an edge;
+	// gather them up and redo them in double. Only the neighbours in this
+	// batch (i.e. along the row) are checked, so edges that run along the
+	// row can be missed; see kernels.h.
+	std::vector<double> redoRe, redoIm;
+	std::vector<int> redoIndex;
+	for (int i = 0; i < count; ++i)
+	{
+		const int n = iterations[i];
+		const bool edge = (i > 0 && std::abs(iterations[i - 1] - n) > 1)
+			|| (i + 1 < count && std::abs(iterations[i + 1] - n) > 1);
+		if (edge)
+		{
+			redoRe.push_back(re[i]);
+			redoIm.push_back(im[i]);
+			redoIndex.push_back(i);
+		}
+	}
+
+	std::vector<int> redone(redoIndex.size());
+	chains_core(start, redoRe.data(), redoIm.data(), (int) redoIndex.size(), maxIterations, redone.data());
+	for (size_t j = 0; j < redoIndex.size(); ++j)
+	{
+		iterations[redoIndex[j]] = redone[j];
+	}
+}
+
+void kernel_hybrid(const double *re, const double *im, int count, int maxIterations, int *iterations)
+{
+	hybrid_core(MandelbrotStart(), re, im, count, maxIterations, iterations);
+}
+
+void kernel_julia_hybrid(const double *re, const double *im, int count, double cRe, double cIm, int maxIterations, int *iterations)
+{
+	hybrid_core(JuliaStart{ cRe, cIm }, re, im, count, maxIterations, iterations);
+}
+
+void kernel_resume(const double *re, const double *im, int count, int maxIterations, double *zRe, double *zIm, int *iterations)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		const double cr = re[i];
+		const double ci = im[i];
+
+		// Exactly as in kernel_scalar, but starting from the saved z.
+		double x = zRe[i], y = zIm[i];
+		double x2 = x * x, y2 = y * y;
+
+		int n = iterations[i];
+		while (x2 + y2 < 4.0 && n < maxIterations)
+		{
+			const double xy = x * y;
+			y = (xy + xy) + ci;
+			x = (x2 - y2) + cr;
+			x2 = x * x;
+			y2 = y * y;
+
+			++n;
+		}
+
+		zRe[i] = x;
+		zIm[i] = y;
+		iterations[i] = n;
+	}
+}
+
+bool in_cardioid_or_bulb(double cr, double ci)
+{
+	const double ci2 = ci * ci;
+
+	// The main cardioid.
+	const double xq = cr - 0.25;
+	const double q = xq * xq + ci2;
+	if (q * (q + xq) <= 0.25 * ci2)
+	{
+		return true;
+	}
+
+	// The circle of radius 1/4 around -1.
+	const double xb = cr + 1.0;
+	return xb * xb + ci2 <= 0.0625;
+}
+
+template <typename Start>
+static long long interior_core(const Start &start, const double *re, const double *im, int count, int maxIterations, int *iterations)
+{
+	long long done = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		if (start.known_inside(re[i], im[i]))
+		{
+			iterations[i] = maxIterations;
+			continue;
+		}
+
+		double x, y, cr, ci;
+		start(re[i], im[i], x, y, cr, ci);
+		double x2 = x * x, y2 = y * y;
+
+		// Most points that escape do so quickly, so don't pay for the
+		// derivative until an orbit has lasted a while.
+		int n = 0;
+		const int warmUp = std::min(maxIterations, INTERIOR_WARM_UP);
+		while (x2 + y2 < 4.0 && n < warmUp)
+		{
+			const double xy = x * y;
+			y = (xy + xy) + ci;
+			x = (x2 - y2) + cr;
+			x2 = x * x;
+			y2 = y * y;
+
+			++n;
+		}
+
+		// From here on, also follow the derivative of z with respect to z
+		// at the end of the warm-up.
+		double dx = 1.0, dy = 0.0;
+		bool attracted = false;
+		while (x2 + y2 < 4.0 && n < maxIterations)
+		{
+			const double xy = x * y;
+			y = (xy + xy) + ci;
+			x = (x2 - y2) + cr;
+			x2 = x * x;
+			y2 = y * y;
+
+			++n;
+
+			// dz = 2 z dz, with the new z, so dz is how much the current z
+			// depends on the z we started measuring from. Any starting
+			// point will do: what matters is whether the orbit has stopped
+			// depending on it.
+			const double ndx = 2.0 * (x * dx - y * dy);
+			dy = 2.0 * (x * dy + y * dx);
+			dx = ndx;
+
+			// Once small changes to z die away, the orbit has been pulled
+			// into an attracting cycle and will never escape. The
+			// derivative only shrinks gradually, so there's no need to look
+			// every time round.
+			if (n % INTERIOR_CHECK_INTERVAL == 0 && dx * dx + dy * dy < INTERIOR_EPSILON * INTERIOR_EPSILON)
+			{
+				attracted = true;
+				break;
+			}
+		}
+
+		done += n;
+		iterations[i] = attracted ? maxIterations : n;
+	}
+	return done;
+}
+
+long long kernel_interior_counted(const double *re, const double *im, int count, int maxIterations, int *iterations)
+{
+	return interior_core(MandelbrotStart(), re, im, count, maxIterations, iterations);
+}
+
+void kernel_interior(const double *re, const double *im, int count, int maxIterations, int *iterations)
+{
+	interior_core(MandelbrotStart(), re, im, count, maxIterations, iterations);
+}
+
+void kernel_julia_interior(const double *re, const double *im, int count, double cRe, double cIm, int maxIterations, int *iterations)
+{
+	interior_core(JuliaStart{ cRe, cIm }, re, im, count, maxIterations, iterations);
+}
+
+const std::vector<Kernel> &all_kernels()
+{
+	static const std::vector<Kernel> kernels = {
+		{ "reference", kernel_reference, kernel_julia_reference, true },
+		{ "scalar", kernel_scalar, kernel_julia_scalar, true },
+		{ "chains", kernel_chains, kernel_julia_chains, true },
+		{ "hybrid", kernel_hybrid, kernel_julia_hybrid, false },
+		{ "interior", kernel_interior, kernel_julia_interior, false },
+	};
+	return kernels;
+}
+
+const Kernel *find_kernel(const std::string &name)
+{
+	for (const Kernel &kernel : all_kernels())
+	{
+		if (name == kernel.name)
+		{
+			return &kernel;
+		}
+	}
+	return nullptr;
+}
+
+// The distance from the set of a point that escaped with z and dz/dc, using
+// the usual estimate |z| log |z| / |dz/dc|, halved to stay on the safe side.
+static double escape_distance(double x, double y, double dx, double dy)
+{
+	const double z = std::sqrt(x * x + y * y);
+	const double dz = std::sqrt(dx * dx + dy * dy);
+	return dz > 0.0 ? 0.5 * z * std::log(z) / dz : 0.0;
+}
+
+void kernel_distance_scalar(const double *re, const double *im, int count, int maxIterations, int *iterations, double *distance)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		const double cr = re[i];
+		const double ci = im[i];
+
+		// z and its derivative dz/dc, which starts at 0 too.
+		double x = 0.0, y = 0.0;
+		double x2 = 0.0, y2 = 0.0;
+		double dx = 0.0, dy = 0.0;
+
+		// z is updated exactly as in kernel_scalar, so the iteration
+		// counts are the same.
+		int n = 0;
+		while (x2 + y2 < 4.0 && n < maxIterations)
+		{
+			// dz/dc = 2 z dz/dc + 1, using the old z.
+			const double ndx = 2.0 * (x * dx - y * dy) + 1.0;
+			dy = 2.0 * (x * dy + y * dx);
+			dx = ndx;
+
+			const double xy = x * y;
+			y = (xy + xy) + ci;
+			x = (x2 - y2) + cr;
+			x2 = x * x;
+			y2 = y * y;
+
+			++n;
+		}
+
+		iterations[i] = n;
+		distance[i] = n < maxIterations ? escape_distance(x, y, dx, dy) : 0.0;
+	}
+}
+
+#ifdef KERNELS_SSE2
+
+// Two points for kernel_distance_simd in one set of SSE registers.
+struct DistanceLanes
+{
+	__m128d cr, ci;
+	__m128d x, y;
+	__m128d x2, y2;
+	__m128d dx, dy;
+	__m128i n;
+
+	void start(const double *re, const double *im)
+	{
+		cr = _mm_loadu_pd(re);
+		ci = _mm_loadu_pd(im);
+		x = y = x2 = y2 = dx = dy = _mm_setzero_pd();
+		n = _mm_setzero_si128();
+	}
+
+	// Do one iteration for the lanes that haven't escaped yet, leaving the
+	// others as they were. Returns a mask of the lanes that iterated.
+	__m128d step()
+	{
+		const __m128d inside = _mm_cmplt_pd(_mm_add_pd(x2, y2), _mm_set1_pd(4.0));
+		const __m128d two = _mm_set1_pd(2.0);
+		const __m128d nextDx = _mm_add_pd(_mm_mul_pd(two, _mm_sub_pd(_mm_mul_pd(x, dx), _mm_mul_pd(y, dy))), _mm_set1_pd(1.0));
+		const __m128d nextDy = _mm_mul_pd(two, _mm_add_pd(_mm_mul_pd(x, dy), _mm_mul_pd(y, dx)));
+		const __m128d xy = _mm_mul_pd(x, y);
+		const __m128d nextY = _mm_add_pd(_mm_add_pd(xy, xy), ci);
+		const __m128d nextX = _mm_add_pd(_mm_sub_pd(x2, y2), cr);
+
+		dx = _mm_or_pd(_mm_and_pd(inside, nextDx), _mm_andnot_pd(inside, dx));
+		dy = _mm_or_pd(_mm_and_pd(inside, nextDy), _mm_andnot_pd(inside, dy));
+		x = _mm_or_pd(_mm_and_pd(inside, nextX), _mm_andnot_pd(inside, x));
+		y = _mm_or_pd(_mm_and_pd(inside, nextY), _mm_andnot_pd(inside, y));
+		x2 = _mm_mul_pd(x, x);
+		y2 = _mm_mul_pd(y, y);
+
+		// The mask is all ones in the lanes that are inside; as 32-bit
+		// integers that's -1 in both halves, and n is only read from the
+		// low half of each lane.
+		n = _mm_sub_epi32(n, _mm_castpd_si128(inside));
+		return inside;
+	}
+
+	void finish(int maxIterations, int *iterations, double *distance, int lanes)
+	{
+		double xs[2], ys[2], dxs[2], dys[2];
+		int ns[4];
+		_mm_storeu_pd(xs, x);
+		_mm_storeu_pd(ys, y);
+		_mm_storeu_pd(dxs, dx);
+		_mm_storeu_pd(dys, dy);
+		_mm_storeu_si128((__m128i *) ns, n);
+		for (int l = 0; l < lanes; ++l)
+		{
+			iterations[l] = ns[2 * l];
+			distance[l] = ns[2 * l] < maxIterations ? escape_distance(xs[l], ys[l], dxs[l], dys[l]) : 0.0;
+		}
+	}
+};
+
+#endif
+
+void kernel_distance_simd(const double *re, const double *im, int count, int maxIterations, int *iterations, double *distance)
+{
+#ifdef KERNELS_SSE2
+	// Four points at a time, in two pairs so that their iterations overlap.
+	int base = 0;
+	for (; base + 4 <= count; base += 4)
+	{
+		DistanceLanes a, b;
+		a.start(re + base, im + base);
+		b.start(re + base + 2, im + base + 2);
+		for (int step = 0; step < maxIterations; ++step)
+		{
+			const __m128d inside = _mm_or_pd(a.step(), b.step());
+			if (_mm_movemask_pd(inside) == 0)
+			{
+				break;
+			}
+		}
+		a.finish(maxIterations, iterations + base, distance + base, 2);
+		b.finish(maxIterations, iterations + base + 2, distance + base + 2, 2);
+	}
+
+	// The last few points on their own.
+	kernel_distance_scalar(re + base, im + base, count - base, maxIterations, iterations + base, distance + base);
+#else
+	kernel_distance_scalar(re, im, count, maxIterations, iterations, distance);
+#endif
+}
+
+const std::vector<DistanceKernel> &all_distance_kernels()
+{
+	static const std::vector<DistanceKernel> kernels = {
+		{ "scalar", kernel_distance_scalar },
+		{ "simd", kernel_distance_simd },
+	};
+	return kernels;
+}
+
+const DistanceKernel *find_distance_kernel(const std::string &name)
+{
+	for (const DistanceKernel &kernel : all_distance_kernels())
+	{
+		if (name == kernel.name)
+		{
+			return &kernel;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,126 @@
+// Escape-time kernels
+// Each kernel is a different implementation of the same inner loop, so that
+// they can be benchmarked and checked against each other.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Iterate z = z^2 + c, starting from z = 0, for each of "count" points
+// c = re[i] + im[i] i. Writes the number of iterations it took each point to
+// move more than 2 units away from (0, 0), or maxIterations if it never did.
+typedef void (*KernelFunc)(const double *re, const double *im, int count, int maxIterations, int *iterations);
+
+// The same for a Julia set: iterate z = z^2 + c with c fixed at cRe + cIm i,
+// starting from z = re[i] + im[i] i for each point.
+typedef void (*JuliaKernelFunc)(const double *re, const double *im, int count, double cRe, double cIm, int maxIterations, int *iterations);
+
+struct Kernel
+{
+	const char *name;
+	KernelFunc func;
+
+	// The same kernel for Julia sets. Both are built from one iteration
+	// loop, which only differs in where z and c start.
+	JuliaKernelFunc julia;
+
+	// True if the kernel does exactly the same double-precision arithmetic as
+	// the reference kernel, so its results must match it exactly.
+	bool exact;
+};
+
+// All the kernels we know about. The first is the reference implementation.
+const std::vector<Kernel> &all_kernels();
+
+// Find a kernel by name. Returns nullptr if there isn't one.
+const Kernel *find_kernel(const std::string &name);
+
+// The reference kernel, using std::complex<double>.
+void kernel_reference(const double *re, const double *im, int count, int maxIterations, int *iterations);
+
+// The same arithmetic written out on the real and imaginary parts, reusing
+// the squares for both the escape test and the next step.
+void kernel_scalar(const double *re, const double *im, int count, int maxIterations, int *iterations);
+
+// kernel_scalar, interleaving several points at once so that their
+// iterations can overlap in the CPU's pipelines.
+void kernel_chains(const double *re, const double *im, int count, int maxIterations, int *iterations);
+
+// Single-precision arithmetic on several points at once. Much faster, but
+// gets some points wrong, and is useless once the points are closer together
+// than a float can resolve. It isn't in all_kernels(), as it gets too many
+// points wrong to pass --verify on its own.
+void kernel_float(const double *re, const double *im, int count, int maxIterations, int *iterations);
+
+// kernel_float, then the points it may have got wrong (those whose neighbours
+// took a different number of iterations) redone with kernel_chains.
+// A kernel only sees one row at a time, so only the neighbours to the left
+// and right are compared. Errors that only show between rows, and points
+// that float wrongly keeps inside the set along with both neighbours, are
+// kept. At 1920x1024 that's 0.0015% of the pixels of WHOLE_SET and 0.096%
+// of ZOOMED.
+void kernel_hybrid(const double *re, const double *im, int count, int maxIterations, int *iterations);
+
+// The Julia versions of the kernels above.
+void kernel_julia_reference(const double *re, const double *im, int count, double cRe, double cIm, int maxIterations, int *iterations);
+void kernel_julia_scalar(const double *re, const double *im, int count, double cRe, double cIm, int maxIterations, int *iterations);
+void kernel_julia_chains(const double *re, const double *im, int count, double cRe, double cIm, int maxIterations, int *iterations);
+void kernel_julia_float(const double *re, const double *im, int count, double cRe, double cIm, int maxIterations, int *iterations);
+void kernel_julia_hybrid(const double *re, const double *im, int count, double cRe, double cIm, int maxIterations, int *iterations);
+
+// Carry on iterating points from where an earlier call stopped: point i had
+// got to z = zRe[i] + zIm[i] i after iterations[i] iterations (all zero to
+// start from scratch). Updates all three, so the points that still haven't
+// escaped can be carried on again later. The results are the same as if
+// kernel_scalar had been run with the final maxIterations in the first place.
+void kernel_resume(const double *re, const double *im, int count, int maxIterations, double *zRe, double *zIm, int *iterations);
+
+// Like KernelFunc, but also tracks dz/dc and writes an estimate of each
+// point's distance from the set: 0 for points that never escaped. The
+// iteration counts are the same as kernel_scalar's.
+typedef void (*DistanceKernelFunc)(const double *re, const double *im, int count, int maxIterations, int *iterations, double *distance);
+
+struct DistanceKernel
+{
+	const char *name;
+	DistanceKernelFunc func;
+};
+
+// All the distance-estimation kernels. The first is the simplest.
+const std::vector<DistanceKernel> &all_distance_kernels();
+
+// Find a distance-estimation kernel by name. Returns nullptr if there isn't one.
+const DistanceKernel *find_distance_kernel(const std::string &name);
+
+void kernel_distance_scalar(const double *re, const double *im, int count, int maxIterations, int *iterations, double *distance);
+
+// kernel_distance_scalar on pairs of points in SSE2 registers, where we have them.
+void kernel_distance_simd(const double *re, const double *im, int count, int maxIterations, int *iterations, double *distance);
+
+// Is c in the main cardioid or the period-2 bulb? Points in there never
+// escape, so there's no need to iterate them.
+bool in_cardioid_or_bulb(double cr, double ci);
+
+// How small the derivative of z with respect to its starting value must get
+// for kernel_interior to decide a point is in the set.
+const double INTERIOR_EPSILON = 1e-9;
+
+// kernel_interior iterates this many times before it starts following the
+// derivative, then only tests it every INTERIOR_CHECK_INTERVAL iterations.
+const int INTERIOR_WARM_UP = 32;
+const int INTERIOR_CHECK_INTERVAL = 8;
+
+// kernel_scalar, also tracking how much z depends on where it started. Once
+// that dependence has died away, the orbit has been attracted to a cycle
+// inside the set, so the point is given maxIterations straight away.
+// That's a heuristic: a point on the edge whose orbit converges very slowly
+// can pass the test and be wrongly counted as inside, so it isn't exact.
+void kernel_interior(const double *re, const double *im, int count, int maxIterations, int *iterations);
+
+// kernel_interior, returning the number of iterations it actually did.
+long long kernel_interior_counted(const double *re, const double *im, int count, int maxIterations, int *iterations);
+
+// kernel_interior for a Julia set, where the derivative is with respect to
+// z after the first iteration, as it is for the Mandelbrot set.
+void kernel_julia_interior(const double *re, const double *im, int count, double cRe, double cIm, int maxIterations, int *iterations);
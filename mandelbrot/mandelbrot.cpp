@@ -2,9 +2,11 @@
 // Adam Sampson <a.sampson@abertay.ac.uk>
 
 #include <chrono>
+#include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
-#include <complex>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <list>
@@ -12,143 +14,74 @@
 #include<algorithm>
 #include <thread>
 
+#include "antialias.h"
+#include "buddhabrot.h"
+#include "checkpoint.h"
+#include "deadline.h"
+#include "deepen.h"
+#include "distance.h"
+#include "distributed.h"
+#include "energy.h"
+#include "golden.h"
+#include "options.h"
+#include "pipeline.h"
+#include "render.h"
+#include "results.h"
+#include "scheduler.h"
+#include "stats.h"
+
 // Import things we need from the standard library
 using std::chrono::duration_cast;
 using std::chrono::milliseconds;
-using std::complex;
+using std::chrono::nanoseconds;
 using std::cout;
 using std::endl;
 using std::ofstream;
 
-ofstream times("mandlebrotTimes.csv");
-
 // Define the alias "the_clock" for the clock type we're going to use.
 typedef std::chrono::steady_clock the_clock;
 
-// The size of the image to generate.
-const int WIDTH = 1920;
-const int HEIGHT = 1024;
-
-// The number of times to iterate before we assume that a point isn't in the
-// Mandelbrot set.
-// (You may need to turn this up if you zoom further into the set.)
-const int MAX_ITERATIONS = 1000;
-
-// The image data.
-// Each pixel is represented as 0xRRGGBB.
-uint32_t image[HEIGHT][WIDTH];
-
-
-// Write the image to a TGA file with the given name.
-// Format specification: http://www.gamers.org/dEngine/quake3/TGA.txt
-void write_tga(const char *filename)
+// Describe a render of the whole frame with the given settings.
+Sample makeSample(const char *benchmark, const RenderSettings &settings, const Frame &frame)
 {
-	ofstream outfile(filename, ofstream::binary);
-
-	uint8_t header[18] = {
-		0, // no image ID
-		0, // no colour map
-		2, // uncompressed 24-bit image
-		0, 0, 0, 0, 0, // empty colour map specification
-		0, 0, // X origin
-		0, 0, // Y origin
-		WIDTH & 0xFF, (WIDTH >> 8) & 0xFF, // width
-		HEIGHT & 0xFF, (HEIGHT >> 8) & 0xFF, // height
-		24, // bits per pixel
-		0, // image descriptor
-	};
-	outfile.write((const char *)header, 18);
-
-	for (int y = 0; y < HEIGHT; ++y)
-	{
-		for (int x = 0; x < WIDTH; ++x)
-		{
-			uint8_t pixel[3] = {
-				image[y][x] & 0xFF, // blue channel
-				(image[y][x] >> 8) & 0xFF, // green channel
-				(image[y][x] >> 16) & 0xFF, // red channel
-			};
-			outfile.write((const char *)pixel, 3);
-		}
-	}
-
-	outfile.close();
-	if (!outfile)
-	{
-		// An error has occurred at some point since we opened the file.
-		cout << "Error writing to " << filename << endl;
-		exit(1);
-	}
+	Sample sample;
+	sample.benchmark = benchmark;
+	sample.kernel = settings.fractal.julia ? std::string("julia_") + settings.kernel->name : settings.kernel->name;
+	sample.scheduler = settings.threads > 1 ? scheduler_name(settings.scheduler) : "serial";
+	sample.threads = settings.threads;
+	sample.symmetry = settings.symmetry ? "on" : "off";
+	sample.left = settings.view.left;
+	sample.right = settings.view.right;
+	sample.top = settings.view.top;
+	sample.bottom = settings.view.bottom;
+	sample.width = frame.width;
+	sample.height = frame.height;
+	sample.maxIterations = frame.maxIterations;
+	return sample;
 }
 
+// The RAPL counters, if this machine has them. See energy.h.
+const EnergyMeter &energyMeter()
+{
+	static const EnergyMeter meter;
+	return meter;
+}
 
-// Render the Mandelbrot set into the image array.
-// The parameters specify the region on the complex plane to plot.
-void compute_mandelbrot(double left, double right, double top, double bottom, int yPosSt, int yPosEnd)
+// Print the energy a sample used, if it was measured.
+void reportEnergy(const Sample &sample)
 {
-	for (int y = yPosSt; y < yPosEnd; ++y)
+	if (sample.energyJ >= 0.0)
 	{
-		for (int x = 0; x < WIDTH; ++x)
-		{
-			// Work out the point in the complex plane that
-			// corresponds to this pixel in the output image.
-			complex<double> c(left + (x * (right - left) / WIDTH), top + (y * (bottom - top) / HEIGHT));
-
-			// Start off z at (0, 0).
-			complex<double> z(0.0, 0.0);
-
-			// Iterate z = z^2 + c until z moves more than 2 units
-			// away from (0, 0), or we've iterated too many times.
-			int iterations = 0;
-
-			// % cost before optimization - ~84.41%
-			
-			// Original @ ~84.41%
-			//while (abs(z) < 2.0 && iterations < MAX_ITERATIONS) // abs(z) = sqrt(z^2) = (abs(z))^2 = z^2
-			//{
-			//	z = (z * z) + c;
-
-			//	++iterations;
-			//}
-
-			// % cost after optimization - ~71.07%
-
-			// Optimized @ ~
-			while (std::norm(z) < 4.0 && iterations < MAX_ITERATIONS) // abs(z) = sqrt(z^2) = (abs(z))^2 = z^2		std::norm - rtns the magnitude squared of a complex number.
-			{
-				z = (z * z) + c;
-
-				++iterations;
-			}
-
-			if (iterations == MAX_ITERATIONS)
-			{
-				// z didn't escape from the circle.
-				// This point is in the Mandelbrot set.
-				image[y][x] = 0x000000; // black
-			}
-			else
-			{
-				// z escaped within less than MAX_ITERATIONS
-				// iterations. This point isn't in the set.
-
-				int red = 255;
-				int green = 100;
-				int blue = 100;
-				int col = (red << 16) | (green << 8) | (blue);
-
-				image[y][x] = (col*iterations) / MAX_ITERATIONS;
-			}
-		}
+		cout << "  " << sample.energyJ << " J, " << (sample.energyJ > 0.0 ? sample.iterations / sample.energyJ / 1e6 : 0.0)
+			<< " million iterations per joule." << endl;
 	}
 }
 
 long long computeMedian(std::list<long long> times)
 {
-	long long median = 0;
 	auto iter = times.begin();
 
-	for (int i = 0; i < times.size() / 2; ++i)
+	for (size_t i = 0; i < times.size() / 2; ++i)
 	{
 		++iter;
 	}
@@ -166,21 +99,32 @@ long long computeMedian(std::list<long long> times)
 	}
 }
 
-std::list<long long> calculateSlices()
+// Print a sorted list of times and their median.
+void reportTimes(std::list<long long> times)
+{
+	times.sort();
+
+	for (auto iter = times.begin(); iter != times.end(); ++iter)
+	{
+		std::cout << *iter << '\n';
+	}
+
+	long long median = computeMedian(times);
+
+	std::cout << "The median of all times: " << median << '\n';
+}
+
+std::list<long long> calculateSlices(const RenderSettings &settings, Frame &frame, ResultsWriter &results)
 {
 	std::list<long long> times;
 	int sliceCounter = 1;
 
-	for (int i = 0; i < HEIGHT; i += 64)
+	for (int i = 0; i < frame.height; i += 64)
 	{
 		// Start timing
 		the_clock::time_point start = the_clock::now();
 
-		// This shows the whole set.
-		//compute_mandelbrot(-2.0, 1.0, 1.125, -1.125, i, i + 64);
-
-		// This zooms in on an interesting bit of detail.
-		compute_mandelbrot(-0.751085, -0.734975, 0.118378, 0.134488, i, i + 64);
+		render_rows(settings, frame, i, std::min(i + 64, frame.height));
 
 		// Stop timing
 		the_clock::time_point end = the_clock::now();
@@ -189,6 +133,12 @@ std::list<long long> calculateSlices()
 		auto time_taken = duration_cast<milliseconds>(end - start).count();
 		cout << "Computing the Mandelbrot slice number " << sliceCounter << " took: " << time_taken << " ms." << endl;
 
+		std::string name = "slice_" + std::to_string(sliceCounter);
+		Sample sample = makeSample(name.c_str(), settings, frame);
+		sample.height = std::min(64, frame.height - i);
+		sample.timeNs = duration_cast<nanoseconds>(end - start).count();
+		results.write(sample);
+
 		++sliceCounter;
 
 		times.push_back(time_taken);
@@ -197,20 +147,22 @@ std::list<long long> calculateSlices()
 	return times;
 }
 
-std::list<long long> runMultipleTimings()
+std::list<long long> runMultipleTimings(const RenderSettings &settings, Frame &frame, int repeats, ResultsWriter &results)
 {
 	std::list<long long> times;
 	int counter = 0;
 
-	while (counter < 7)
+	// Warm up.
+	render_rows(settings, frame, 16, std::min(498, frame.height));
+
+	while (counter < repeats)
 	{
-		// This shows the whole set.
-		compute_mandelbrot(-2.0, 1.0, 1.125, -1.125, 16, 498);
+		EnergyReading energyStart = energyMeter().read();
 
 		// Start timing
 		the_clock::time_point start = the_clock::now();
 
-		compute_mandelbrot(-2.0, 1.0, 1.125, -1.125, 0, HEIGHT);
+		render_frame(settings, frame);
 
 		// Stop timing
 		the_clock::time_point end = the_clock::now();
@@ -219,10 +171,14 @@ std::list<long long> runMultipleTimings()
 		auto time_taken = duration_cast<milliseconds>(end - start).count();
 		cout << "Computing the Mandelbrot set took: " << time_taken << " ms." << endl;
 
-		times.push_back(time_taken);
+		Sample sample = makeSample("repeat", settings, frame);
+		sample.timeNs = duration_cast<nanoseconds>(end - start).count();
+		sample.energyJ = energyMeter().joules(energyStart, energyMeter().read());
+		sample.iterations = frame_iterations(frame);
+		reportEnergy(sample);
+		results.write(sample);
 
-		// This zooms in on an interesting bit of detail.
-		//compute_mandelbrot(-0.751085, -0.734975, 0.118378, 0.134488);
+		times.push_back(time_taken);
 
 		++counter;
 	}
@@ -230,102 +186,660 @@ std::list<long long> runMultipleTimings()
 	return times;
 }
 
-void standardMandlebrot()
+// Render the frame and encode it as a TGA image, colouring and encoding each
+// tile as soon as it has been computed rather than after the whole frame.
+// Returns the time taken in nanoseconds.
+long long streamMandlebrot(const RenderSettings &settings, Frame &frame, std::vector<uint8_t> &tga)
+{
+	tga.resize(tga_size(frame));
+
+	// Start timing
+	the_clock::time_point start = the_clock::now();
+
+	render_streaming(settings, frame, [&](int yPosSt, int yPosEnd) {
+		colour_mandelbrot(frame, yPosSt, yPosEnd);
+		encode_tga_rows(frame, tga.data(), yPosSt, yPosEnd);
+	});
+
+	// Stop timing
+	the_clock::time_point end = the_clock::now();
+
+	return duration_cast<nanoseconds>(end - start).count();
+}
+
+// Compare the time from starting a render to having the encoded image,
+// first colouring and encoding after every thread has finished, then
+// streaming tiles to the encoder as they finish.
+void runStreamingTimings(const RenderSettings &settings, Frame &frame, int repeats, ResultsWriter &results)
 {
-	// This shows the whole set.
-	//compute_mandelbrot(-2.0, 1.0, 1.125, -1.125, 16, 498);
+	std::vector<uint8_t> tga;
+	std::vector<double> joined, streamed;
+
+	for (int run = 0; run < repeats; ++run)
+	{
+		the_clock::time_point start = the_clock::now();
+		render_frame(settings, frame);
+		colour_mandelbrot(frame, 0, frame.height);
+		encode_tga(frame, tga);
+		Sample sample = makeSample("encode_after_join", settings, frame);
+		sample.pipeline = "joined";
+		sample.timeNs = duration_cast<nanoseconds>(the_clock::now() - start).count();
+		results.write(sample);
+		joined.push_back((double) sample.timeNs);
+
+		sample = makeSample("encode_streamed", settings, frame);
+		sample.pipeline = "streamed";
+		sample.timeNs = streamMandlebrot(settings, frame, tga);
+		results.write(sample);
+		streamed.push_back((double) sample.timeNs);
+
+		cout << "Run " << (run + 1) << " of " << repeats << ": "
+			<< (long long) joined.back() / 1000000 << " ms after join, "
+			<< (long long) streamed.back() / 1000000 << " ms streamed." << endl;
+	}
 
-	// Zoomed in.
-	//compute_mandelbrot(-0.751085, -0.734975, 0.118378, 0.134488, 0, HEIGHT);
+	cout << "Median: " << median(joined) / 1e6 << " ms after join, " << median(streamed) / 1e6
+		<< " ms streamed (speedup " << median(joined) / median(streamed) << "x)." << endl;
+}
 
+// Render the frame by handing tiles out to worker processes.
+void distributedMandlebrot(const RenderSettings &settings, Frame &frame, const Options &options, ResultsWriter &results)
+{
 	// Start timing
 	the_clock::time_point start = the_clock::now();
 
-	compute_mandelbrot(-2.0, 1.0, 1.125, -1.125, 0, HEIGHT);
+	render_distributed(settings, frame, options.coordinator, options.spawnWorkers, options.tileTimeout);
 
 	// Stop timing
 	the_clock::time_point end = the_clock::now();
 
 	// Compute the difference between the two times in milliseconds
 	auto time_taken = duration_cast<milliseconds>(end - start).count();
-	cout << "Computing the Mandelbrot set took: " << time_taken << " ms." << endl;
 
-	// This zooms in on an interesting bit of detail.
-	//compute_mandelbrot(-0.751085, -0.734975, 0.118378, 0.134488);
+	cout << "Computing the Mandelbrot set across worker processes took: " << time_taken << " ms." << endl;
+
+	Sample sample = makeSample("distributed", settings, frame);
+	sample.scheduler = "distributed";
+	sample.timeNs = duration_cast<nanoseconds>(end - start).count();
+	results.write(sample);
 }
 
-void standardMandlebrot_Th(int increment)
+// Zoom from the whole set in to the view in settings, rendering each frame
+// within budgetMs, as an interactive viewer would.
+void runDeadlineTimings(const RenderSettings &settings, Frame &frame, double budgetMs, const char *output, ResultsWriter &results)
 {
-	std::vector<std::thread> mbThreads;
+	const int frames = 60;
+	View target = settings.view;
+	if (memcmp(&target, &WHOLE_SET, sizeof target) == 0)
+	{
+		target = ZOOMED;
+	}
 
-	// Start timing
-	the_clock::time_point start = the_clock::now();
+	DeadlineRenderer renderer(settings);
+	const double startWidth = WHOLE_SET.right - WHOLE_SET.left;
+	const double endWidth = target.right - target.left;
+	for (int i = 0; i < frames; ++i)
+	{
+		// Shrink the view by the same factor each frame, moving its centre
+		// along in proportion.
+		const double width = startWidth * std::pow(endWidth / startWidth, (double) i / (frames - 1));
+		const double along = (startWidth - width) / (startWidth - endWidth);
+		const double height = width * (WHOLE_SET.bottom - WHOLE_SET.top) / startWidth;
+		const double centreX = (1.0 - along) * (WHOLE_SET.left + WHOLE_SET.right) / 2 + along * (target.left + target.right) / 2;
+		const double centreY = (1.0 - along) * (WHOLE_SET.top + WHOLE_SET.bottom) / 2 + along * (target.top + target.bottom) / 2;
+		const View view = { centreX - width / 2, centreX + width / 2, centreY - height / 2, centreY + height / 2 };
+
+		DeadlineFrame result = renderer.render_with_deadline(view, frame.width, frame.height, frame.maxIterations, budgetMs);
+
+		cout << "Frame " << (i + 1) << ": 1/" << result.scale << " size, " << result.frame->maxIterations << " iterations, "
+			<< result.passes << " passes, " << result.elapsedMs << " ms" << (result.hitDeadline ? "" : " (late)") << endl;
+
+		RenderSettings frameSettings = settings;
+		frameSettings.view = view;
+		std::string name = "deadline_" + std::to_string(i + 1);
+		Sample sample = makeSample(name.c_str(), frameSettings, *result.frame);
+		sample.timeNs = (long long) (result.elapsedMs * 1e6);
+		results.write(sample);
+
+		if (i == frames - 1)
+		{
+			upscale_frame(*result.frame, result.scale, frame);
+		}
+	}
+
+	cout << renderer.deadlinesHit() << " of " << renderer.frames() << " frames were within " << budgetMs << " ms." << endl;
+
+	colour_mandelbrot(frame, 0, frame.height);
+	write_tga(frame, output);
+}
 
-	// 1020 is the terminating condition as this accounts for rounding(floor) of division by 8.
-	for (int i = 0; i < 1020; i += increment)
+// Compare the iterations done by kernel_interior with brute force on the
+// whole set and the zoomed-in view, checking that every pixel comes out the same.
+void runInteriorStats(RenderSettings settings, Frame &frame, ResultsWriter &results)
+{
+	const View views[] = { WHOLE_SET, ZOOMED };
+	const char *names[] = { "whole_set", "zoom" };
+	for (int v = 0; v < 2; ++v)
 	{
-		// Zoomed in.
-		//mbThreads.push_back(std::thread(compute_mandelbrot, -0.751085, -0.734975, 0.118378, 0.134488, i, i + increment));
+		settings.view = views[v];
+		settings.kernel = find_kernel("scalar");
+		Frame brute(frame.width, frame.height, frame.maxIterations);
+		Sample bruteSample = makeSample((std::string("interior_brute_") + names[v]).c_str(), settings, brute);
+		the_clock::time_point start = the_clock::now();
+		compute_mandelbrot(*settings.kernel, settings.view, brute, 0, brute.height);
+		bruteSample.timeNs = duration_cast<nanoseconds>(the_clock::now() - start).count();
+		bruteSample.iterations = frame_iterations(brute);
+		results.write(bruteSample);
+
+		// The same rows as compute_rows, keeping count of the iterations.
+		settings.kernel = find_kernel("interior");
+		Sample sample = makeSample((std::string("interior_") + names[v]).c_str(), settings, frame);
+		start = the_clock::now();
+		long long done = 0;
+		std::vector<double> re(frame.width), im(frame.width);
+		for (int x = 0; x < frame.width; ++x)
+		{
+			re[x] = column_real(settings.view, frame.width, x);
+		}
+		for (int y = 0; y < frame.height; ++y)
+		{
+			std::fill(im.begin(), im.end(), row_imag(settings.view, frame.height, y));
+			done += kernel_interior_counted(re.data(), im.data(), frame.width, frame.maxIterations, frame.row(y));
+		}
+		sample.timeNs = duration_cast<nanoseconds>(the_clock::now() - start).count();
+		sample.iterations = done;
+		results.write(sample);
+
+		long long mismatches = 0;
+		for (size_t i = 0; i < frame.iterations.size(); ++i)
+		{
+			if (frame.iterations[i] != brute.iterations[i])
+			{
+				++mismatches;
+			}
+		}
 
-		// Whole set.
-		mbThreads.push_back(std::thread(compute_mandelbrot, -2.0, 1.0, 1.125, -1.125, i, i + increment));
+		cout << names[v] << ": brute force did " << bruteSample.iterations << " iterations in " << bruteSample.timeNs / 1000000
+			<< " ms; interior detection did " << done << " (" << 100.0 * (bruteSample.iterations - done) / bruteSample.iterations
+			<< "% saved) in " << sample.timeNs / 1000000 << " ms; " << mismatches << " pixels differ." << endl;
 	}
+}
+
+// Render the frame with distance estimates and shade it by them.
+void distanceMandlebrot(const RenderSettings &settings, Frame &frame, const DistanceKernel &kernel, ResultsWriter &results)
+{
+	std::vector<double> distance;
+
+	// Start timing
+	the_clock::time_point start = the_clock::now();
+
+	render_distance(kernel, settings, frame, distance);
+
+	// Stop timing
+	the_clock::time_point end = the_clock::now();
+
+	Sample sample = makeSample("render_distance", settings, frame);
+	sample.kernel = std::string("distance_") + kernel.name;
+	sample.scheduler = "dynamic";
+	sample.timeNs = duration_cast<nanoseconds>(end - start).count();
+	results.write(sample);
 
-	for (int i = 0; i < mbThreads.size(); ++i)
+	// The pixels that aren't uniform: those in or near the set.
+	const double size = pixel_size(settings.view, frame);
+	long long near = 0;
+	for (double d : distance)
 	{
-		if (mbThreads[i].joinable())
+		if (!far_from_set(d, size))
 		{
-			mbThreads[i].join();
+			++near;
 		}
 	}
 
+	cout << "Computing the Mandelbrot set with distance estimates took: " << sample.timeNs / 1000000 << " ms; "
+		<< near << " pixels (" << 100.0 * near / distance.size() << "%) are within a pixel of the set." << endl;
+
+	colour_distance(frame, distance, size, 0, frame.height);
+}
+
+// Render and colour a Buddhabrot of the view from samples random points.
+void buddhabrotMandlebrot(const RenderSettings &settings, Frame &frame, long long samples, ResultsWriter &results)
+{
+	VisitCounts counts;
+
+	// Start timing
+	the_clock::time_point start = the_clock::now();
+
+	long long visits = render_buddhabrot(*settings.kernel, settings.view, frame, samples, settings.threads, 1, counts);
+
 	// Stop timing
 	the_clock::time_point end = the_clock::now();
 
-	// Compute the difference between the two times in milliseconds
-	auto time_taken = duration_cast<milliseconds>(end - start).count();
+	Sample sample = makeSample("render_buddhabrot", settings, frame);
+	sample.scheduler = "dynamic";
+	sample.timeNs = duration_cast<nanoseconds>(end - start).count();
+	sample.iterations = visits;
+	results.write(sample);
 
-	cout << "Computing the Mandelbrot set with " << mbThreads.size() << " threads took: " << time_taken << " ms." << endl;
+	cout << "Computing a Buddhabrot from " << samples << " points with " << settings.threads << " threads took: "
+		<< sample.timeNs / 1000000 << " ms (" << samples / (sample.timeNs / 1e9) / 1e6 << " million points/s); "
+		<< visits << " orbit points landed in the view." << endl;
 
-	times << time_taken << ",\n";
+	colour_buddhabrot(frame, counts);
 }
 
-void runMultiMbThreadTimings()
+// Render and colour a Buddhabrot of the view from samples steps of
+// Metropolis-Hastings chains, and report how well they converged.
+void metropolisMandlebrot(const RenderSettings &settings, Frame &frame, long long samples, ResultsWriter &results)
 {
-	int counter = 1.0f;
-	int increment = HEIGHT / counter;
+	VisitDensity density;
+	MetropolisStats stats;
+
+	// Start timing
+	the_clock::time_point start = the_clock::now();
 
-	while (counter < 9)
+	render_buddhabrot_metropolis(*settings.kernel, settings.view, frame, samples, settings.threads, 1, density, stats);
+
+	// Stop timing
+	the_clock::time_point end = the_clock::now();
+
+	Sample sample = makeSample("render_buddhabrot_metropolis", settings, frame);
+	sample.scheduler = "metropolis";
+	sample.timeNs = duration_cast<nanoseconds>(end - start).count();
+	results.write(sample);
+
+	cout << "Computing a Buddhabrot from " << stats.steps << " Metropolis-Hastings steps with " << settings.threads
+		<< " threads took: " << sample.timeNs / 1000000 << " ms." << endl;
+	if (stats.chains == 0)
 	{
-		standardMandlebrot_Th(increment);
-		++counter;
-		increment = HEIGHT / counter;
+		cout << "No orbits through the view were found in " << stats.startTries << " tries." << endl;
+	}
+	else
+	{
+		cout << stats.chains << " chains started after " << stats.startTries << " tries, and burned in for "
+			<< METROPOLIS_BURN_IN << " steps each." << endl
+			<< "Acceptance rate: " << 100.0 * stats.accepted / std::max(1LL, stats.steps) << "%; R-hat: " << stats.rHat
+			<< (stats.rHat > 1.1 ? " (not converged: try more points)" : "") << endl;
 	}
+
+	colour_buddhabrot(frame, density);
+}
+
+// Render and colour the frame, then supersample the pixels on edges, timing
+// both passes.
+void antialiasMandlebrot(const RenderSettings &settings, Frame &frame, int samplesPerSide, double edgeRatio, ResultsWriter &results)
+{
+	Sample plain = makeSample("antialias_render", settings, frame);
+	the_clock::time_point start = the_clock::now();
+	render_frame(settings, frame);
+	colour_mandelbrot(frame, 0, frame.height);
+	plain.timeNs = duration_cast<nanoseconds>(the_clock::now() - start).count();
+	results.write(plain);
+
+	Sample extra = makeSample("antialias_edges", settings, frame);
+	start = the_clock::now();
+	long long edges = antialias_frame(settings, frame, samplesPerSide, edgeRatio);
+	extra.timeNs = duration_cast<nanoseconds>(the_clock::now() - start).count();
+	results.write(extra);
+
+	cout << "Computing the Mandelbrot set took: " << plain.timeNs / 1000000 << " ms." << endl
+		<< "Supersampling " << edges << " edge pixels (" << 100.0 * edges / ((double) frame.width * frame.height)
+		<< "%) with " << samplesPerSide * samplesPerSide << " samples each took: " << extra.timeNs / 1000000
+		<< " ms (" << 100.0 * extra.timeNs / plain.timeNs << "% extra)." << endl;
+}
+
+// Render with frame.maxIterations, then carry on the pixels that didn't
+// escape up to maxIterations, timing each step.
+void deepenMandlebrot(RenderSettings settings, Frame &frame, int maxIterations, ResultsWriter &results)
+{
+	// Both steps use kernel_resume, whatever kernel was asked for.
+	settings.kernel = find_kernel("scalar");
+	settings.symmetry = false;
+
+	SavedOrbits orbits;
+	Sample first = makeSample("deepen_initial", settings, frame);
+	the_clock::time_point start = the_clock::now();
+	render_saving_orbits(settings.view, frame, settings.threads, orbits);
+	first.timeNs = duration_cast<nanoseconds>(the_clock::now() - start).count();
+	results.write(first);
+
+	cout << "Computing the Mandelbrot set with " << frame.maxIterations << " iterations took: "
+		<< first.timeNs / 1000000 << " ms; " << orbits.size() << " pixels didn't escape." << endl;
+
+	const int previous = frame.maxIterations;
+	start = the_clock::now();
+	deepen_frame(frame, maxIterations, settings.threads, orbits);
+	Sample second = makeSample("deepen", settings, frame);
+	second.timeNs = duration_cast<nanoseconds>(the_clock::now() - start).count();
+	results.write(second);
+
+	cout << "Going from " << previous << " to " << maxIterations << " iterations took: "
+		<< second.timeNs / 1000000 << " ms; " << orbits.size() << " pixels still didn't escape." << endl;
+}
+
+void runMultiMbThreadTimings(RenderSettings settings, Frame &frame, ResultsWriter &results)
+{
+	for (int threads = 1; threads < 9; ++threads)
+	{
+		settings.threads = threads;
+
+		EnergyReading energyStart = energyMeter().read();
+
+		// Start timing
+		the_clock::time_point start = the_clock::now();
+
+		render_frame(settings, frame);
+
+		// Stop timing
+		the_clock::time_point end = the_clock::now();
+
+		// Compute the difference between the two times in milliseconds
+		auto time_taken = duration_cast<milliseconds>(end - start).count();
+
+		cout << "Computing the Mandelbrot set with " << threads << " threads took: " << time_taken << " ms." << endl;
+
+		std::string name = "threads_" + std::to_string(threads);
+		Sample sample = makeSample(name.c_str(), settings, frame);
+		sample.timeNs = duration_cast<nanoseconds>(end - start).count();
+		sample.energyJ = energyMeter().joules(energyStart, energyMeter().read());
+		sample.iterations = frame_iterations(frame);
+		reportEnergy(sample);
+		results.write(sample);
+	}
+}
+
+// Run the standard benchmark suite: the whole set, the zoomed-in view, and
+// the zoomed-in view computed in 64-row slices.
+// The view in settings is ignored; everything else is used as given.
+// Each case is timed "repeats" times, and every sample is recorded.
+std::vector<Sample> runStandardSuite(RenderSettings settings, Frame &frame, int repeats, ResultsWriter &results)
+{
+	std::vector<Sample> samples;
+
+	for (int run = 0; run < repeats; ++run)
+	{
+		settings.view = WHOLE_SET;
+		Sample whole = makeSample("whole_set", settings, frame);
+		EnergyReading energyStart = energyMeter().read();
+		the_clock::time_point start = the_clock::now();
+		render_frame(settings, frame);
+		whole.timeNs = duration_cast<nanoseconds>(the_clock::now() - start).count();
+		whole.energyJ = energyMeter().joules(energyStart, energyMeter().read());
+		whole.iterations = frame_iterations(frame);
+		samples.push_back(whole);
+
+		settings.view = ZOOMED;
+		Sample zoom = makeSample("zoom", settings, frame);
+		energyStart = energyMeter().read();
+		start = the_clock::now();
+		render_frame(settings, frame);
+		zoom.timeNs = duration_cast<nanoseconds>(the_clock::now() - start).count();
+		zoom.energyJ = energyMeter().joules(energyStart, energyMeter().read());
+		zoom.iterations = frame_iterations(frame);
+		samples.push_back(zoom);
+
+		Sample slices = makeSample("zoom_slices", settings, frame);
+		energyStart = energyMeter().read();
+		start = the_clock::now();
+		for (int i = 0; i < frame.height; i += 64)
+		{
+			render_rows(settings, frame, i, std::min(i + 64, frame.height));
+		}
+		slices.timeNs = duration_cast<nanoseconds>(the_clock::now() - start).count();
+		slices.energyJ = energyMeter().joules(energyStart, energyMeter().read());
+		slices.iterations = frame_iterations(frame);
+		samples.push_back(slices);
+
+		cout << "Suite run " << (run + 1) << " of " << repeats << ": "
+			<< whole.timeNs / 1000000 << " ms, "
+			<< zoom.timeNs / 1000000 << " ms, "
+			<< slices.timeNs / 1000000 << " ms." << endl;
+	}
+
+	for (const Sample &sample : samples)
+	{
+		results.write(sample);
+	}
+
+	return samples;
+}
+
+// Rerun the standard suite and compare it against the samples in a baseline
+// results file.
+// Returns 1 if any benchmark's median is more than thresholdPercent slower
+// than the baseline and a Mann-Whitney test says the difference is
+// significant; otherwise returns 0.
+int compareWithBaseline(const RenderSettings &settings, Frame &frame, const Options &options, ResultsWriter &results)
+{
+	const double SIGNIFICANCE = 0.05;
+
+	std::vector<Sample> baseline = read_results(options.baseline);
+	std::vector<Sample> current = runStandardSuite(settings, frame, options.repeats, results);
+
+	int regressions = 0;
+	const char *benchmarks[] = { "whole_set", "zoom", "zoom_slices" };
+	for (const char *name : benchmarks)
+	{
+		// Only compare like with like: same kernel, scheduler, threads,
+		// symmetry, pipeline, image size and iterations.
+		const Sample like = makeSample(name, settings, frame);
+		std::vector<double> before, after;
+		for (const Sample &sample : current)
+		{
+			if (sample.benchmark == name)
+			{
+				after.push_back((double) sample.timeNs);
+			}
+		}
+		for (const Sample &sample : baseline)
+		{
+			if (sample.benchmark == name && sample.kernel == like.kernel && sample.scheduler == like.scheduler && sample.threads == like.threads
+				&& sample.symmetry == like.symmetry && sample.pipeline == like.pipeline
+				&& sample.width == like.width && sample.height == like.height && sample.maxIterations == like.maxIterations)
+			{
+				before.push_back((double) sample.timeNs);
+			}
+		}
+
+		if (before.empty())
+		{
+			cout << name << ": no matching baseline samples, skipped." << endl;
+			continue;
+		}
+
+		const double change = (median(after) / median(before) - 1.0) * 100.0;
+		const MannWhitneyResult test = mann_whitney_u(before, after);
+		const bool regressed = change > options.threshold && test.pValue < SIGNIFICANCE;
+
+		cout << name << ": baseline " << median(before) / 1e6 << " ms, current " << median(after) / 1e6
+			<< " ms, change " << change << "% (speedup " << median(before) / median(after) << "x), p = " << test.pValue
+			<< (regressed ? "  REGRESSION" : "") << endl;
+
+		if (regressed)
+		{
+			++regressions;
+		}
+	}
+
+	if (regressions > 0)
+	{
+		cout << regressions << " benchmark(s) slower than the baseline by more than " << options.threshold << "%." << endl;
+		return 1;
+	}
+	return 0;
 }
 
 int main(int argc, char *argv[])
 {
+	Options options = parse_options(argc, argv);
+
+	if (!options.worker.empty())
+	{
+		return run_worker(options.worker, options.threads);
+	}
+
+	RenderSettings settings;
+	settings.view = options.view;
+	settings.kernel = find_kernel(options.kernel);
+	settings.threads = options.threads;
+	settings.scheduler = options.scheduler;
+	settings.symmetry = options.symmetry;
+	settings.fractal = options.fractal;
+	settings.hangTimeout = options.hangTimeout;
+
+	if (options.autoIterations)
+	{
+		options.maxIterations = choose_iterations(options.view, options.width, options.height, options.threads);
+		cout << "Using " << options.maxIterations << " iterations." << endl;
+	}
+
+	// The image data.
+	Frame frame(options.width, options.height, options.maxIterations);
+
+	// One record per timed render; see results.h for the fields.
+	ResultsWriter results(options.results);
+
 	cout << "Please wait..." << endl;
 
-	//standardMandlebrot();
-	//std::list<long long> times = runMultipleTimings();
-	//std::list<long long> times = calculateSlices();
+	if (!options.golden.empty())
+	{
+		write_golden(options.golden);
+		return 0;
+	}
+	if (!options.verify.empty())
+	{
+		return verify_kernels(options.verify, options.tolerance) == 0 ? 0 : 1;
+	}
 
-	/*times.sort();
+	if (options.bench == "suite")
+	{
+		runStandardSuite(settings, frame, options.repeats, results);
+		return 0;
+	}
+	if (options.bench == "compare")
+	{
+		return compareWithBaseline(settings, frame, options, results);
+	}
 
-	for (auto iter = times.begin(); iter != times.end(); ++iter)
+	if (options.bench == "threads")
 	{
-		std::cout << *iter << '\n';
+		runMultiMbThreadTimings(settings, frame, results);
+	}
+	else if (options.bench == "slices")
+	{
+		reportTimes(calculateSlices(settings, frame, results));
+	}
+	else if (options.bench == "repeat")
+	{
+		reportTimes(runMultipleTimings(settings, frame, options.repeats, results));
+	}
+	else if (options.deepen != 0)
+	{
+		deepenMandlebrot(settings, frame, options.deepen, results);
+	}
+	else if (!options.distance.empty())
+	{
+		distanceMandlebrot(settings, frame, *find_distance_kernel(options.distance), results);
+		write_tga(frame, options.output.c_str());
+		return 0;
+	}
+	else if (options.buddhabrot > 0)
+	{
+		if (options.sampler == "metropolis")
+		{
+			metropolisMandlebrot(settings, frame, options.buddhabrot * 1000000LL, results);
+		}
+		else
+		{
+			buddhabrotMandlebrot(settings, frame, options.buddhabrot * 1000000LL, results);
+		}
+		write_tga(frame, options.output.c_str());
+		return 0;
+	}
+	else if (options.antialias > 0)
+	{
+		antialiasMandlebrot(settings, frame, options.antialias, options.edgeRatio, results);
+		write_tga(frame, options.output.c_str());
+		return 0;
 	}
+	else if (!options.checkpoint.empty())
+	{
+		// Start timing
+		the_clock::time_point start = the_clock::now();
 
-	long long median = computeMedian(times);
+		render_checkpointed(settings, frame, options.checkpoint, options.checkpointInterval, options.resume);
+
+		// Stop timing
+		the_clock::time_point end = the_clock::now();
+
+		Sample sample = makeSample("render_checkpointed", settings, frame);
+		sample.scheduler = "dynamic";
+		sample.timeNs = duration_cast<nanoseconds>(end - start).count();
+		results.write(sample);
+
+		cout << "Computing the Mandelbrot set with " << settings.threads << " threads took: "
+			<< duration_cast<milliseconds>(end - start).count() << " ms." << endl;
+
+		colour_mandelbrot(frame, 0, frame.height);
+		write_tga(frame, options.output.c_str());
+		std::remove(options.checkpoint.c_str());
+		return 0;
+	}
+	else if (!options.coordinator.empty())
+	{
+		distributedMandlebrot(settings, frame, options, results);
+	}
+	else if (options.bench == "interior")
+	{
+		runInteriorStats(settings, frame, results);
+	}
+	else if (options.bench == "deadline")
+	{
+		runDeadlineTimings(settings, frame, options.budget, options.output.c_str(), results);
+		return 0;
+	}
+	else if (options.bench == "stream")
+	{
+		runStreamingTimings(settings, frame, options.repeats, results);
+	}
+	else if (options.pipeline == "coroutines")
+	{
+		// Start timing
+		the_clock::time_point start = the_clock::now();
+
+		render_coroutines(settings, frame, options.output.c_str());
 
-	std::cout << "The median of all times: " << median << '\n';*/
+		// Stop timing
+		the_clock::time_point end = the_clock::now();
+
+		Sample sample = makeSample("render_coroutines", settings, frame);
+		sample.scheduler = "coroutines";
+		sample.pipeline = "coroutines";
+		sample.timeNs = duration_cast<nanoseconds>(end - start).count();
+		results.write(sample);
+
+		cout << "Computing and writing the Mandelbrot set with " << settings.threads << " threads took: "
+			<< duration_cast<milliseconds>(end - start).count() << " ms." << endl;
+		return 0;
+	}
+	else
+	{
+		// The image is encoded as the tiles finish, so there's nothing
+		// left to do afterwards but write it out.
+		std::vector<uint8_t> tga;
+		Sample sample = makeSample("render_streamed", settings, frame);
+		sample.pipeline = "streamed";
+		sample.timeNs = streamMandlebrot(settings, frame, tga);
+		results.write(sample);
+
+		cout << "Computing and encoding the Mandelbrot set with " << settings.threads << " threads took: "
+			<< sample.timeNs / 1000000 << " ms." << endl;
+
+		write_tga_data(tga, options.output.c_str());
+		return 0;
+	}
 
-	//standardMandlebrot_Th();
-	runMultiMbThreadTimings();
-	
-	write_tga("output.tga");
+	colour_mandelbrot(frame, 0, frame.height);
+	write_tga(frame, options.output.c_str());
 
 	return 0;
 }
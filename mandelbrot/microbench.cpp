@@ -0,0 +1,452 @@
+// Microbenchmarks for the separate stages of rendering
+// In the style of Google Benchmark: each benchmark is run repeatedly until it
+// has taken at least --min-time seconds, then we report the time per run.
+//
+// Usage: mandelbrot_bench [--filter text] [--min-time seconds]
+//                         [--threads 1,2,4] [--results file]
+
+#include <algorithm>
+#include <barrier>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "kernels.h"
+#include "render.h"
+#include "results.h"
+
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::cout;
+using std::endl;
+using std::string;
+
+typedef std::chrono::steady_clock the_clock;
+
+// The number of points in each kernel batch.
+const int BATCH_SIZE = 4096;
+
+// Threads that are started once for a benchmark and then split up the work
+// of each run, so that the runs don't time starting and joining threads.
+class SplitPool
+{
+public:
+	explicit SplitPool(int threads)
+		: threads(std::max(1, threads)), sync(this->threads)
+	{
+		for (int t = 1; t < this->threads; ++t)
+		{
+			workers.push_back(std::thread(&SplitPool::worker, this, t));
+		}
+	}
+
+	~SplitPool()
+	{
+		stopping = true;
+		if (!workers.empty())
+		{
+			sync.arrive_and_wait();
+		}
+		for (std::thread &worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	// Split [0, count) into contiguous chunks, one per thread, and run
+	// func(start, end) on each. This thread does the first chunk.
+	void split(int count, const std::function<void(int, int)> &func)
+	{
+		if (threads == 1)
+		{
+			func(0, count);
+			return;
+		}
+
+		job = &func;
+		jobCount = count;
+		sync.arrive_and_wait();
+		run_chunk(0);
+		sync.arrive_and_wait();
+	}
+
+private:
+	void run_chunk(int t)
+	{
+		const int start = (int) ((long long) jobCount * t / threads);
+		const int end = (int) ((long long) jobCount * (t + 1) / threads);
+		(*job)(start, end);
+	}
+
+	// Each run passes the barrier twice: once to start, once to finish.
+	void worker(int t)
+	{
+		while (true)
+		{
+			sync.arrive_and_wait();
+			if (stopping)
+			{
+				return;
+			}
+			run_chunk(t);
+			sync.arrive_and_wait();
+		}
+	}
+
+	const int threads;
+	std::barrier<> sync;
+	std::vector<std::thread> workers;
+
+	// Only written while the workers are waiting at the barrier.
+	const std::function<void(int, int)> *job = nullptr;
+	int jobCount = 0;
+	bool stopping = false;
+};
+
+struct Benchmark
+{
+	string name;
+	string kernel;
+	int threads;
+
+	// The pixels processed by each run, as width * height.
+	int width, height;
+
+	// One run, sharing its work out over a pool of "threads" threads.
+	std::function<void(SplitPool &)> run;
+};
+
+// A batch of points for the kernel benchmarks.
+struct PointBatch
+{
+	const char *name;
+	std::vector<double> re, im;
+};
+
+// Points well inside the main cardioid, which never escape.
+PointBatch interior_batch()
+{
+	PointBatch batch = { "interior" };
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<double> dist(-0.1, 0.1);
+	for (int i = 0; i < BATCH_SIZE; ++i)
+	{
+		batch.re.push_back(-0.2 + dist(rng));
+		batch.im.push_back(dist(rng));
+	}
+	return batch;
+}
+
+// A 64x64 grid over the zoomed-in view, which is mostly near the boundary.
+PointBatch boundary_batch()
+{
+	PointBatch batch = { "boundary" };
+	for (int y = 0; y < 64; ++y)
+	{
+		for (int x = 0; x < BATCH_SIZE / 64; ++x)
+		{
+			batch.re.push_back(ZOOMED.left + x * (ZOOMED.right - ZOOMED.left) / (BATCH_SIZE / 64));
+			batch.im.push_back(ZOOMED.top + y * (ZOOMED.bottom - ZOOMED.top) / 64);
+		}
+	}
+	return batch;
+}
+
+// Points between 2.5 and 3 units from the origin, which escape at once.
+PointBatch escaping_batch()
+{
+	PointBatch batch = { "escaping" };
+	std::mt19937 rng(2);
+	std::uniform_real_distribution<double> radius(2.5, 3.0);
+	std::uniform_real_distribution<double> angle(0.0, 6.283185307179586);
+	for (int i = 0; i < BATCH_SIZE; ++i)
+	{
+		double r = radius(rng);
+		double a = angle(rng);
+		batch.re.push_back(r * std::cos(a));
+		batch.im.push_back(r * std::sin(a));
+	}
+	return batch;
+}
+
+// The Julia set the julia/ benchmarks render: connected, with plenty of
+// boundary and interior.
+const Fractal BENCH_JULIA = { true, -0.8, 0.156 };
+
+// A 64x64 grid over the usual view of a Julia set.
+PointBatch julia_batch()
+{
+	PointBatch batch = { "grid" };
+	for (int y = 0; y < 64; ++y)
+	{
+		for (int x = 0; x < BATCH_SIZE / 64; ++x)
+		{
+			batch.re.push_back(JULIA_SET.left + x * (JULIA_SET.right - JULIA_SET.left) / (BATCH_SIZE / 64));
+			batch.im.push_back(JULIA_SET.top + y * (JULIA_SET.bottom - JULIA_SET.top) / 64);
+		}
+	}
+	return batch;
+}
+
+std::vector<Benchmark> make_benchmarks(const std::vector<int> &threadCounts)
+{
+	std::vector<Benchmark> benchmarks;
+
+	// Shared inputs and outputs for the benchmarks. These are kept alive by
+	// the lambdas that use them.
+	auto batches = std::make_shared<std::vector<PointBatch>>();
+	batches->push_back(interior_batch());
+	batches->push_back(boundary_batch());
+	batches->push_back(escaping_batch());
+	auto results = std::make_shared<std::vector<int>>(BATCH_SIZE);
+
+	// A frame of the whole set, for the colour and write stages.
+	auto frame = std::make_shared<Frame>();
+	compute_mandelbrot(all_kernels()[0], WHOLE_SET, *frame, 0, frame->height);
+	colour_mandelbrot(*frame, 0, frame->height);
+	auto encoded = std::make_shared<std::vector<uint8_t>>(tga_size(*frame));
+
+	for (const Kernel &kernel : all_kernels())
+	{
+		for (const PointBatch &batch : *batches)
+		{
+			for (int threads : threadCounts)
+			{
+				Benchmark b;
+				b.name = string("kernel/") + batch.name + "/" + kernel.name + "/threads:" + std::to_string(threads);
+				b.kernel = kernel.name;
+				b.threads = threads;
+				b.width = BATCH_SIZE;
+				b.height = 1;
+				const Kernel *k = &kernel;
+				const PointBatch *p = &batch;
+				b.run = [k, p, batches, results](SplitPool &pool) {
+					pool.split(BATCH_SIZE, [&](int start, int end) {
+						k->func(&p->re[start], &p->im[start], end - start, MAX_ITERATIONS, &(*results)[start]);
+					});
+				};
+				benchmarks.push_back(b);
+			}
+		}
+	}
+
+	// The same kernels on a Julia set.
+	auto julia = std::make_shared<PointBatch>(julia_batch());
+	for (const Kernel &kernel : all_kernels())
+	{
+		for (int threads : threadCounts)
+		{
+			Benchmark b;
+			b.name = string("julia/") + julia->name + "/" + kernel.name + "/threads:" + std::to_string(threads);
+			b.kernel = string("julia_") + kernel.name;
+			b.threads = threads;
+			b.width = BATCH_SIZE;
+			b.height = 1;
+			const Kernel *k = &kernel;
+			b.run = [k, julia, results](SplitPool &pool) {
+				pool.split(BATCH_SIZE, [&](int start, int end) {
+					compute_points(*k, BENCH_JULIA, &julia->re[start], &julia->im[start], end - start, MAX_ITERATIONS, &(*results)[start]);
+				});
+			};
+			benchmarks.push_back(b);
+		}
+	}
+
+	// The distance kernels do the same iterations as the scalar kernel,
+	// so compare them with kernel/*/scalar for their overhead.
+	auto distances = std::make_shared<std::vector<double>>(BATCH_SIZE);
+	for (const DistanceKernel &kernel : all_distance_kernels())
+	{
+		for (const PointBatch &batch : *batches)
+		{
+			for (int threads : threadCounts)
+			{
+				Benchmark b;
+				b.name = string("distance/") + batch.name + "/" + kernel.name + "/threads:" + std::to_string(threads);
+				b.kernel = string("distance_") + kernel.name;
+				b.threads = threads;
+				b.width = BATCH_SIZE;
+				b.height = 1;
+				const DistanceKernel *k = &kernel;
+				const PointBatch *p = &batch;
+				b.run = [k, p, batches, results, distances](SplitPool &pool) {
+					pool.split(BATCH_SIZE, [&](int start, int end) {
+						k->func(&p->re[start], &p->im[start], end - start, MAX_ITERATIONS, &(*results)[start], &(*distances)[start]);
+					});
+				};
+				benchmarks.push_back(b);
+			}
+		}
+	}
+
+	for (int threads : threadCounts)
+	{
+		Benchmark b;
+		b.name = "colour/threads:" + std::to_string(threads);
+		b.kernel = "";
+		b.threads = threads;
+		b.width = frame->width;
+		b.height = frame->height;
+		b.run = [frame](SplitPool &pool) {
+			pool.split(frame->height, [&](int start, int end) {
+				colour_mandelbrot(*frame, start, end);
+			});
+		};
+		benchmarks.push_back(b);
+	}
+
+	for (int threads : threadCounts)
+	{
+		Benchmark b;
+		b.name = "write_tga/threads:" + std::to_string(threads);
+		b.kernel = "";
+		b.threads = threads;
+		b.width = frame->width;
+		b.height = frame->height;
+		b.run = [frame, encoded](SplitPool &pool) {
+			pool.split(frame->height, [&](int start, int end) {
+				encode_tga_rows(*frame, encoded->data(), start, end);
+			});
+		};
+		benchmarks.push_back(b);
+	}
+
+	return benchmarks;
+}
+
+// Run a benchmark until it has taken at least minTime seconds.
+// Returns the mean time per run in nanoseconds, and the number of runs.
+double time_benchmark(const Benchmark &b, double minTime, long long &runs)
+{
+	SplitPool pool(b.threads);
+
+	// Warm up.
+	b.run(pool);
+
+	runs = 0;
+	long long batch = 1;
+	long long elapsed = 0;
+	while (elapsed < minTime * 1e9)
+	{
+		the_clock::time_point start = the_clock::now();
+		for (long long i = 0; i < batch; ++i)
+		{
+			b.run(pool);
+		}
+		elapsed += duration_cast<nanoseconds>(the_clock::now() - start).count();
+		runs += batch;
+		batch *= 2;
+	}
+
+	return (double) elapsed / runs;
+}
+
+void usage()
+{
+	cout << "Usage: mandelbrot_bench [--filter text] [--min-time seconds] [--threads 1,2,4] [--results file]" << endl;
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	string filter;
+	double minTime = 0.5;
+	std::vector<int> threadCounts = { 1 };
+	if (std::thread::hardware_concurrency() > 1)
+	{
+		threadCounts.push_back((int) std::thread::hardware_concurrency());
+	}
+	std::unique_ptr<ResultsWriter> results;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			usage();
+		}
+		else if (strcmp(argv[i], "--filter") == 0)
+		{
+			filter = argv[++i];
+		}
+		else if (strcmp(argv[i], "--min-time") == 0)
+		{
+			minTime = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--threads") == 0)
+		{
+			threadCounts.clear();
+			std::istringstream list(argv[++i]);
+			string item;
+			while (std::getline(list, item, ','))
+			{
+				int threads = atoi(item.c_str());
+				if (threads < 1)
+				{
+					usage();
+				}
+				threadCounts.push_back(threads);
+			}
+		}
+		else if (strcmp(argv[i], "--results") == 0)
+		{
+			results.reset(new ResultsWriter(argv[++i]));
+		}
+		else
+		{
+			usage();
+		}
+	}
+
+	cout << std::left << std::setw(44) << "Benchmark"
+		<< std::right << std::setw(16) << "Time"
+		<< std::setw(12) << "Runs"
+		<< std::setw(18) << "Pixels/s" << endl;
+	cout << string(90, '-') << endl;
+
+	for (const Benchmark &b : make_benchmarks(threadCounts))
+	{
+		if (b.name.find(filter) == string::npos)
+		{
+			continue;
+		}
+
+		long long runs;
+		double ns = time_benchmark(b, minTime, runs);
+
+		std::ostringstream time;
+		time << std::fixed << std::setprecision(0) << ns << " ns";
+		std::ostringstream rate;
+		rate << std::setprecision(4) << (double) b.width * b.height / (ns / 1e9);
+
+		cout << std::left << std::setw(44) << b.name
+			<< std::right << std::setw(16) << time.str()
+			<< std::setw(12) << runs
+			<< std::setw(18) << rate.str() << endl;
+
+		if (results)
+		{
+			Sample sample;
+			sample.benchmark = b.name;
+			sample.kernel = b.kernel;
+			sample.scheduler = "split";
+			sample.threads = b.threads;
+			sample.width = b.width;
+			sample.height = b.height;
+			sample.maxIterations = MAX_ITERATIONS;
+			sample.timeNs = (long long) ns;
+			results->write(sample);
+		}
+	}
+
+	return 0;
+}
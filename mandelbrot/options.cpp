@@ -0,0 +1,425 @@
+// Command-line options
+
+#include "options.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using std::cout;
+using std::endl;
+using std::string;
+
+static void usage(const string &error)
+{
+	if (!error.empty())
+	{
+		cout << "Error: " << error << endl << endl;
+	}
+
+	cout << "Usage: mandelbrot [options]" << endl
+		<< endl
+		<< "  --view L,R,T,B       region of the complex plane to plot, or \"whole\" or \"zoom\"" << endl
+		<< "                       (default whole: -2,1,1.125,-1.125)" << endl
+		<< "  --julia RE,IM        render the Julia set for c = RE + IM i instead of the Mandelbrot set" << endl
+		<< "                       (default view -1.875,1.875,1,-1)" << endl
+		<< "  --size WxH           image size in pixels (default " << WIDTH << "x" << HEIGHT << ")" << endl
+		<< "  --iterations N       iterations before a point is assumed to be in the set (default " << MAX_ITERATIONS << ")" << endl
+		<< "                       or \"auto\" to pick the fewest that are enough for the view" << endl
+		<< "  --threads N          worker threads, or 0 for one per core (default 1)" << endl
+		<< "  --kernel NAME        escape-time kernel:";
+	for (const Kernel &kernel : all_kernels())
+	{
+		cout << " " << kernel.name;
+	}
+	cout << " (default " << Options().kernel << ")" << endl
+		<< "  --scheduler NAME     how rows are shared between threads: static dynamic" << endl
+		<< "                       process (worker processes that survive crashes)" << endl
+		<< "  --hang-timeout SECS  with --scheduler process, restart a worker stuck on one tile this long" << endl
+		<< "                       (default 0, never)" << endl
+		<< "  --symmetry on|off    copy rows mirrored about the real axis instead of computing them (default on)" << endl
+		<< "  --pipeline NAME      how a single render is coloured, encoded and written:" << endl
+		<< "                         streamed    encode tiles on this thread as they finish (default)" << endl
+		<< "                         coroutines  one coroutine per tile on a pool of --threads threads" << endl
+		<< "  --distance NAME      shade by estimated distance from the set, using a distance kernel:";
+	for (const DistanceKernel &kernel : all_distance_kernels())
+	{
+		cout << " " << kernel.name;
+	}
+	cout << endl
+		<< "  --antialias N        supersample pixels on edges with NxN samples (default 0, off)" << endl
+		<< "  --edge-ratio R       with --antialias, a pixel is on an edge if a neighbour took more than R times" << endl
+		<< "                       as many iterations (default " << DEFAULT_EDGE_RATIO << ")" << endl
+		<< "  --buddhabrot M       render a Buddhabrot of --view from M million random points" << endl
+		<< "  --sampler NAME       how the Buddhabrot's points are chosen:" << endl
+		<< "                         uniform     evenly over the plane (default)" << endl
+		<< "                         metropolis  Metropolis-Hastings chains that favour orbits through the view" << endl
+		<< "  --output FILE        TGA image to write (default output.tga)" << endl
+		<< "  --results FILE       benchmark results, .csv or .jsonl (default mandelbrotResults.csv)" << endl
+		<< endl
+		<< "  --bench MODE         run a benchmark instead of a single render:" << endl
+		<< "                         threads  time 1 to 8 threads" << endl
+		<< "                         slices   time each 64-row slice" << endl
+		<< "                         repeat   time several renders and report the median" << endl
+		<< "                         suite    run the standard suite (e.g. to record a baseline)" << endl
+		<< "                         compare  run the suite and fail if slower than --baseline" << endl
+		<< "                         stream   time render-to-encoded-image with and without streaming" << endl
+		<< "                         deadline zoom in to --view, rendering each frame within --budget" << endl
+		<< "                         interior iterations saved by the interior kernel on the standard views" << endl
+		<< "  --repeats N          renders per benchmark case (default 7)" << endl
+		<< "  --baseline FILE      results file to compare against" << endl
+		<< "  --threshold PERCENT  slowdown that counts as a regression (default 10)" << endl
+		<< "  --budget MS          time allowed for each frame of --bench deadline (default 33)" << endl
+		<< endl
+		<< "  --deepen N           render with --iterations, then carry on the pixels that didn't escape up to N" << endl
+		<< "                       (always uses the scalar arithmetic, without symmetry)" << endl
+		<< endl
+		<< "  --checkpoint FILE    save finished tiles to FILE as the render goes, and remove it once the image is written" << endl
+		<< "  --checkpoint-interval SECS  how often to save the checkpoint (default 60)" << endl
+		<< "  --resume             carry on from the --checkpoint file, if there is one" << endl
+		<< endl
+		<< "  --golden DIR         render the standard views with the reference kernel and store them in DIR" << endl
+		<< "  --verify DIR         check every kernel and scheduler against the golden buffers in DIR" << endl
+		<< "  --tolerance FRACTION share of pixels approximate kernels may get wrong (default " << DEFAULT_MISMATCH_TOLERANCE << ")" << endl
+		<< endl
+		<< "  --coordinator ADDR   render by handing tiles to worker processes; ADDR is host:port or unix:/path" << endl
+		<< "  --spawn-workers N    start N local workers for the coordinator" << endl
+		<< "  --tile-timeout SECS  give a tile to another worker after this long (default: automatic)" << endl
+		<< "  --worker ADDR        render tiles for the coordinator at ADDR, using --threads threads" << endl;
+	exit(error.empty() ? 0 : 1);
+}
+
+static int parse_int(const string &option, const char *value, int min, int max = INT_MAX)
+{
+	char *end;
+	errno = 0;
+	long result = strtol(value, &end, 10);
+	if (*value == '\0' || *end != '\0' || errno == ERANGE || result < min || result > max)
+	{
+		usage("bad value for " + option + ": " + value);
+	}
+	return (int) result;
+}
+
+static double parse_double(const string &option, const char *value)
+{
+	char *end;
+	double result = strtod(value, &end);
+	if (*value == '\0' || *end != '\0' || !std::isfinite(result))
+	{
+		usage("bad value for " + option + ": " + value);
+	}
+	return result;
+}
+
+static View parse_view(const char *value)
+{
+	if (strcmp(value, "whole") == 0)
+	{
+		return WHOLE_SET;
+	}
+	if (strcmp(value, "zoom") == 0)
+	{
+		return ZOOMED;
+	}
+
+	double parts[4];
+	std::istringstream list(value);
+	string item;
+	for (int i = 0; i < 4; ++i)
+	{
+		if (!std::getline(list, item, ','))
+		{
+			usage(string("--view needs four numbers: ") + value);
+		}
+		parts[i] = parse_double("--view", item.c_str());
+	}
+	if (std::getline(list, item, ','))
+	{
+		usage(string("--view needs four numbers: ") + value);
+	}
+
+	View view = { parts[0], parts[1], parts[2], parts[3] };
+	if (view.left == view.right || view.top == view.bottom)
+	{
+		usage(string("--view is empty: ") + value);
+	}
+	return view;
+}
+
+Options parse_options(int argc, char *argv[])
+{
+	Options options;
+	bool viewGiven = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string option = argv[i];
+		if (option == "--help" || option == "-h")
+		{
+			usage("");
+		}
+		if (option.compare(0, 2, "--") != 0)
+		{
+			usage("unexpected argument " + option);
+		}
+		if (option == "--resume")
+		{
+			// The only option without a value.
+			options.resume = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			usage(option + " needs a value");
+		}
+		const char *value = argv[++i];
+
+		if (option == "--view")
+		{
+			options.view = parse_view(value);
+			viewGiven = true;
+		}
+		else if (option == "--julia")
+		{
+			const char *comma = strchr(value, ',');
+			if (comma == nullptr)
+			{
+				usage(string("--julia should look like -0.8,0.156: ") + value);
+			}
+			options.fractal.julia = true;
+			options.fractal.cRe = parse_double(option, string(value, comma).c_str());
+			options.fractal.cIm = parse_double(option, comma + 1);
+		}
+		else if (option == "--size")
+		{
+			const char *x = strchr(value, 'x');
+			if (x == nullptr)
+			{
+				usage(string("--size should look like 1920x1024: ") + value);
+			}
+			options.width = parse_int(option, string(value, x).c_str(), 1);
+			options.height = parse_int(option, x + 1, 1);
+			if (options.width > 0xFFFF || options.height > 0xFFFF)
+			{
+				// The TGA header only has 16 bits for each.
+				usage(string("--size is too big for a TGA file: ") + value);
+			}
+		}
+		else if (option == "--iterations")
+		{
+			options.autoIterations = string(value) == "auto";
+			if (!options.autoIterations)
+			{
+				options.maxIterations = parse_int(option, value, 1);
+			}
+		}
+		else if (option == "--threads")
+		{
+			options.threads = parse_int(option, value, 0);
+			if (options.threads == 0)
+			{
+				options.threads = std::max(1u, std::thread::hardware_concurrency());
+			}
+		}
+		else if (option == "--kernel")
+		{
+			if (find_kernel(value) == nullptr)
+			{
+				usage(string("unknown kernel ") + value);
+			}
+			options.kernel = value;
+		}
+		else if (option == "--scheduler")
+		{
+			if (!parse_scheduler(value, options.scheduler))
+			{
+				usage(string("unknown scheduler ") + value);
+			}
+		}
+		else if (option == "--hang-timeout")
+		{
+			options.hangTimeout = parse_double(option, value);
+		}
+		else if (option == "--distance")
+		{
+			if (find_distance_kernel(value) == nullptr)
+			{
+				usage(string("unknown distance kernel ") + value);
+			}
+			options.distance = value;
+		}
+		else if (option == "--antialias")
+		{
+			options.antialias = parse_int(option, value, 0);
+		}
+		else if (option == "--edge-ratio")
+		{
+			options.edgeRatio = parse_double(option, value);
+			if (options.edgeRatio <= 1.0)
+			{
+				usage("--edge-ratio must be more than 1");
+			}
+		}
+		else if (option == "--buddhabrot")
+		{
+			options.buddhabrot = parse_int(option, value, 1);
+		}
+		else if (option == "--sampler")
+		{
+			options.sampler = value;
+			if (options.sampler != "uniform" && options.sampler != "metropolis")
+			{
+				usage(string("unknown sampler ") + value);
+			}
+		}
+		else if (option == "--output")
+		{
+			options.output = value;
+		}
+		else if (option == "--results")
+		{
+			options.results = value;
+		}
+		else if (option == "--symmetry")
+		{
+			if (string(value) != "on" && string(value) != "off")
+			{
+				usage(string("--symmetry must be on or off: ") + value);
+			}
+			options.symmetry = string(value) == "on";
+		}
+		else if (option == "--pipeline")
+		{
+			options.pipeline = value;
+			if (options.pipeline != "streamed" && options.pipeline != "coroutines")
+			{
+				usage(string("unknown pipeline ") + value);
+			}
+		}
+		else if (option == "--bench")
+		{
+			options.bench = value;
+			if (options.bench != "threads" && options.bench != "slices" && options.bench != "repeat"
+				&& options.bench != "suite" && options.bench != "compare" && options.bench != "stream"
+				&& options.bench != "deadline" && options.bench != "interior")
+			{
+				usage(string("unknown benchmark mode ") + value);
+			}
+		}
+		else if (option == "--repeats")
+		{
+			options.repeats = parse_int(option, value, 1);
+		}
+		else if (option == "--baseline")
+		{
+			options.baseline = value;
+		}
+		else if (option == "--threshold")
+		{
+			options.threshold = parse_double(option, value);
+		}
+		else if (option == "--deepen")
+		{
+			options.deepen = parse_int(option, value, 1);
+		}
+		else if (option == "--checkpoint")
+		{
+			options.checkpoint = value;
+		}
+		else if (option == "--checkpoint-interval")
+		{
+			options.checkpointInterval = parse_double(option, value);
+		}
+		else if (option == "--budget")
+		{
+			options.budget = parse_double(option, value);
+		}
+		else if (option == "--golden")
+		{
+			options.golden = value;
+		}
+		else if (option == "--verify")
+		{
+			options.verify = value;
+		}
+		else if (option == "--tolerance")
+		{
+			options.tolerance = parse_double(option, value);
+		}
+		else if (option == "--coordinator")
+		{
+			options.coordinator = value;
+		}
+		else if (option == "--worker")
+		{
+			options.worker = value;
+		}
+		else if (option == "--spawn-workers")
+		{
+			options.spawnWorkers = parse_int(option, value, 0);
+		}
+		else if (option == "--tile-timeout")
+		{
+			options.tileTimeout = parse_double(option, value);
+		}
+		else
+		{
+			usage("unknown option " + option);
+		}
+	}
+
+	// Each of these is a different thing to do instead of a plain render,
+	// and main() would only do the first it came across.
+	const bool modes[] = {
+		!options.golden.empty(), !options.verify.empty(), !options.bench.empty(),
+		!options.coordinator.empty(), !options.worker.empty(), options.buddhabrot != 0,
+		options.deepen != 0, !options.distance.empty(), options.antialias != 0, !options.checkpoint.empty(),
+	};
+	if (std::count(std::begin(modes), std::end(modes), true) > 1)
+	{
+		usage("only one of --golden, --verify, --bench, --coordinator, --worker, --buddhabrot, --deepen, --distance, --antialias and --checkpoint can be used at a time");
+	}
+
+	if (options.bench == "compare" && options.baseline.empty())
+	{
+		usage("--bench compare needs --baseline");
+	}
+
+	if (options.fractal.julia)
+	{
+		if (!viewGiven)
+		{
+			options.view = JULIA_SET;
+		}
+
+		// These only know about the Mandelbrot set.
+		if (options.deepen != 0 || options.autoIterations || !options.distance.empty() || options.buddhabrot != 0
+			|| options.bench == "suite" || options.bench == "compare" || options.bench == "deadline" || options.bench == "interior")
+		{
+			usage("--julia can't be used with --deepen, --iterations auto, --distance, --buddhabrot, or --bench suite, compare, deadline or interior");
+		}
+	}
+
+	if (options.resume && options.checkpoint.empty())
+	{
+		usage("--resume needs --checkpoint");
+	}
+
+	if (options.deepen != 0 && options.autoIterations)
+	{
+		usage("--deepen needs a fixed number of --iterations");
+	}
+	if (options.deepen != 0 && options.deepen <= options.maxIterations)
+	{
+		usage("--deepen must be more than --iterations");
+	}
+
+	return options;
+}
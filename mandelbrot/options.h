@@ -0,0 +1,88 @@
+// Command-line options
+
+#pragma once
+
+#include <string>
+
+#include "antialias.h"
+#include "golden.h"
+#include "render.h"
+#include "scheduler.h"
+
+struct Options
+{
+	View view = WHOLE_SET;
+
+	// The Mandelbrot set, or a Julia set with --julia.
+	Fractal fractal;
+	int width = WIDTH;
+	int height = HEIGHT;
+	int maxIterations = MAX_ITERATIONS;
+
+	// Pick maxIterations to suit the view; see choose_iterations().
+	bool autoIterations = false;
+
+	int threads = 1;
+	std::string kernel = "scalar";
+	Scheduler scheduler = Scheduler::Static;
+	bool symmetry = true;
+
+	// Kill process-scheduler workers stuck on a tile this long; 0 for never.
+	double hangTimeout = 0.0;
+
+	// How a single render becomes an image: "streamed" or "coroutines".
+	std::string pipeline = "streamed";
+
+	// If set, render with this distance-estimation kernel and shade by
+	// distance from the set. See distance.h.
+	std::string distance;
+
+	// Supersample edge pixels with this many samples per side; 0 for none.
+	int antialias = 0;
+
+	// How different neighbouring pixels' iteration counts must be for
+	// --antialias to supersample them.
+	double edgeRatio = DEFAULT_EDGE_RATIO;
+
+	// If non-zero, render a Buddhabrot from this many million random
+	// points instead. See buddhabrot.h.
+	int buddhabrot = 0;
+
+	// How the Buddhabrot's points are chosen: "uniform" or "metropolis".
+	std::string sampler = "uniform";
+
+	// Where the image and benchmark results go.
+	std::string output = "output.tga";
+	std::string results = "mandelbrotResults.csv";
+
+	// Which benchmark to run, or "" to just render an image.
+	std::string bench;
+	int repeats = 7;
+	std::string baseline;
+	double threshold = 10.0;
+	double budget = 33.0;
+
+	// If non-zero, render with maxIterations and then raise the limit to
+	// this, carrying on from where the first render stopped.
+	int deepen = 0;
+
+	// Save finished tiles to this file as the render goes, and pick up
+	// from it if resume is set. See checkpoint.h.
+	std::string checkpoint;
+	double checkpointInterval = 60.0;
+	bool resume = false;
+
+	// Golden iteration buffers to write, or to check the kernels against.
+	std::string golden;
+	std::string verify;
+	double tolerance = DEFAULT_MISMATCH_TOLERANCE;
+
+	// Rendering across processes: see distributed.h.
+	std::string coordinator;
+	std::string worker;
+	int spawnWorkers = 0;
+	double tileTimeout = 0.0;
+};
+
+// Parse the command line. Prints a usage message and exits if it's invalid.
+Options parse_options(int argc, char *argv[]);
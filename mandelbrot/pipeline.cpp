@@ -0,0 +1,113 @@
+// Rendering straight to a file as a pipeline of coroutines
+
+#include "pipeline.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <latch>
+#include <vector>
+
+#include "coroutines.h"
+#include "symmetry.h"
+
+using std::cout;
+using std::endl;
+using std::ofstream;
+
+// Everything the tile coroutines share.
+struct Pipeline
+{
+	const RenderSettings &settings;
+	Frame &frame;
+	const RowPlan &plan;
+	CoroutinePool &pool;
+
+	// Only one tile writes to the file at a time. The writes are ordinary
+	// blocking ones, made on whichever pool thread holds the lock.
+	AsyncMutex fileLock;
+	ofstream &outfile;
+
+	// Counted down as each tile is written.
+	std::latch &done;
+};
+
+// Encoded rows, ready to write at "offset" in the file.
+struct EncodedRows
+{
+	size_t offset;
+	std::vector<uint8_t> pixels;
+};
+
+// Colour and encode rows [yPosSt, yPosEnd).
+static EncodedRows encode_rows(Frame &frame, int yPosSt, int yPosEnd)
+{
+	colour_mandelbrot(frame, yPosSt, yPosEnd);
+
+	EncodedRows rows;
+	rows.offset = tga_row_offset(frame, yPosSt);
+	rows.pixels.resize(tga_row_offset(frame, yPosEnd) - rows.offset);
+	encode_tga_pixels(frame, rows.pixels.data(), yPosSt, yPosEnd);
+	return rows;
+}
+
+static DetachedTask tile_task(Pipeline &pipeline, int yPosSt, int yPosEnd)
+{
+	Frame &frame = pipeline.frame;
+
+	// The heavy work happens on the pool...
+	co_await pipeline.pool.schedule();
+
+	compute_mandelbrot(*pipeline.settings.kernel, pipeline.settings.view, frame, yPosSt, yPosEnd, pipeline.settings.fractal);
+
+	// The tile, and any rows that are mirror images of it.
+	std::vector<EncodedRows> bands;
+	bands.push_back(encode_rows(frame, yPosSt, yPosEnd));
+	mirror_rows(pipeline.plan, frame, yPosSt, yPosEnd, [&](int mirrorSt, int mirrorEnd) {
+		bands.push_back(encode_rows(frame, mirrorSt, mirrorEnd));
+	});
+
+	// ... and the write on whichever thread gets the file next.
+	co_await pipeline.fileLock.lock();
+	for (const EncodedRows &band : bands)
+	{
+		pipeline.outfile.seekp(band.offset);
+		pipeline.outfile.write((const char *) band.pixels.data(), band.pixels.size());
+	}
+	pipeline.fileLock.unlock();
+
+	pipeline.done.count_down();
+}
+
+void render_coroutines(const RenderSettings &settings, Frame &frame, const char *filename)
+{
+	ofstream outfile(filename, ofstream::binary);
+
+	// The header is all of the file before row 0.
+	std::vector<uint8_t> header(tga_row_offset(frame, 0));
+	encode_tga_rows(frame, header.data(), 0, 0);
+	outfile.write((const char *) header.data(), header.size());
+
+	const RowPlan plan = plan_rows(settings, frame, TILE_ROWS);
+	std::latch done(plan.tiles.size());
+	{
+		CoroutinePool pool(std::max(1, settings.threads));
+		Pipeline pipeline{ settings, frame, plan, pool, AsyncMutex(pool), outfile, done };
+
+		for (const auto &tile : plan.tiles)
+		{
+			tile_task(pipeline, tile.first, tile.second);
+		}
+
+		done.wait();
+	}
+
+	outfile.close();
+	if (!outfile)
+	{
+		// An error has occurred at some point since we opened the file.
+		cout << "Error writing to " << filename << endl;
+		exit(1);
+	}
+}
@@ -0,0 +1,13 @@
+// Rendering straight to a file as a pipeline of coroutines
+
+#pragma once
+
+#include "render.h"
+#include "scheduler.h"
+
+// Render the frame and write it to a TGA file, with one coroutine per tile
+// of TILE_ROWS rows. Each tile is computed, coloured and encoded on a pool
+// of settings.threads threads, then written at its own offset in the file,
+// along with any rows that are its mirror image. settings.scheduler is
+// ignored.
+void render_coroutines(const RenderSettings &settings, Frame &frame, const char *filename);
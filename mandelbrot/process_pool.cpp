@@ -0,0 +1,325 @@
+// Rendering in separate worker processes
+
+#include "process_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::cout;
+using std::endl;
+
+typedef std::chrono::steady_clock the_clock;
+
+#ifdef _WIN32
+
+void render_processes(const RenderSettings &, Frame &, int, int)
+{
+	cout << "The process scheduler needs fork(), which isn't available on this platform." << endl;
+	exit(1);
+}
+
+#else
+
+// The atomics below are shared between processes, which only works if they
+// don't hide a lock inside the process.
+static_assert(std::atomic<int32_t>::is_always_lock_free, "need lock-free 32-bit atomics");
+static_assert(std::atomic<int64_t>::is_always_lock_free, "need lock-free 64-bit atomics");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "need lock-free 64-bit atomics");
+
+struct SharedTile
+{
+	// 0 if nobody's working on it, otherwise the worker's slot + 1.
+	std::atomic<int32_t> owner;
+
+	// How many workers have started on it.
+	std::atomic<int32_t> attempts;
+};
+
+struct SharedWorker
+{
+	// When the worker started its current tile, or 0 if it hasn't got one.
+	std::atomic<int64_t> tileStartedNs;
+};
+
+// The start of the shared-memory region. The completion bitmap, tiles and
+// workers follow it. The frame's own iterations are shared already (see
+// allocate_frame_memory), so they're not in here.
+struct SharedHeader
+{
+	std::atomic<int32_t> nextTile;
+	std::atomic<int32_t> tilesDone;
+	std::atomic<int64_t> totalTileNs;
+};
+
+// Pointers into the shared region.
+struct SharedFrame
+{
+	SharedHeader *header;
+	std::atomic<uint64_t> *doneBits;
+	SharedTile *tiles;
+	SharedWorker *workers;
+};
+
+static int64_t now_ns()
+{
+	return duration_cast<nanoseconds>(the_clock::now().time_since_epoch()).count();
+}
+
+static bool tile_done(const SharedFrame &shared, int tile)
+{
+	return (shared.doneBits[tile / 64].load(std::memory_order_acquire) >> (tile % 64)) & 1;
+}
+
+static void mark_done(SharedFrame &shared, int tile)
+{
+	shared.doneBits[tile / 64].fetch_or((uint64_t) 1 << (tile % 64), std::memory_order_release);
+	shared.header->tilesDone.fetch_add(1);
+}
+
+// Claim a tile for the worker in the given slot. Returns -1 if there's
+// nothing to do right now.
+static int claim_tile(SharedFrame &shared, int tiles, int slot)
+{
+	// Usually the next tile nobody has touched...
+	int tile = shared.header->nextTile.fetch_add(1);
+	int32_t expected = 0;
+	if (tile < tiles && shared.tiles[tile].owner.compare_exchange_strong(expected, slot + 1))
+	{
+		return tile;
+	}
+
+	// ... but once those have run out, look for tiles whose worker died.
+	for (tile = 0; tile < tiles; ++tile)
+	{
+		expected = 0;
+		if (!tile_done(shared, tile) && shared.tiles[tile].owner.load() == 0
+			&& shared.tiles[tile].owner.compare_exchange_strong(expected, slot + 1))
+		{
+			return tile;
+		}
+	}
+	return -1;
+}
+
+// Kill and reap every worker that's still running.
+static void kill_workers(const std::vector<pid_t> &pids)
+{
+	for (pid_t pid : pids)
+	{
+		if (pid > 0)
+		{
+			kill(pid, SIGKILL);
+			while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR)
+			{
+			}
+		}
+	}
+}
+
+static void worker_main(const RenderSettings &settings, Frame &frame, SharedFrame &shared, int tiles, int slot, int yPosSt, int yPosEnd)
+{
+	SharedWorker &me = shared.workers[slot];
+
+	while (shared.header->tilesDone.load() < tiles)
+	{
+		int tile = claim_tile(shared, tiles, slot);
+		if (tile < 0)
+		{
+			// Other workers have everything, but one of them might die.
+			usleep(1000);
+			continue;
+		}
+
+		const int y0 = yPosSt + tile * TILE_ROWS;
+		const int y1 = std::min(y0 + TILE_ROWS, yPosEnd);
+		const int64_t start = now_ns();
+		me.tileStartedNs.store(start);
+		shared.tiles[tile].attempts.fetch_add(1);
+
+		compute_mandelbrot(*settings.kernel, settings.view, frame, y0, y1, settings.fractal);
+
+		mark_done(shared, tile);
+		shared.header->totalTileNs.fetch_add(now_ns() - start);
+		me.tileStartedNs.store(0);
+	}
+}
+
+void render_processes(const RenderSettings &settings, Frame &frame, int yPosSt, int yPosEnd)
+{
+	yPosSt = std::max(yPosSt, frame.firstRow);
+	yPosEnd = std::min(yPosEnd, frame.firstRow + frame.rows);
+	if (yPosSt >= yPosEnd)
+	{
+		return;
+	}
+
+	const int workers = std::max(1, settings.threads);
+	const int tiles = (yPosEnd - yPosSt + TILE_ROWS - 1) / TILE_ROWS;
+	const int bitmapWords = (tiles + 63) / 64;
+
+	// Lay out the shared region, keeping everything suitably aligned.
+	size_t size = sizeof(SharedHeader);
+	const size_t bitsOffset = size;
+	size += bitmapWords * sizeof(uint64_t);
+	const size_t tilesOffset = size;
+	size += tiles * sizeof(SharedTile);
+	const size_t workersOffset = size;
+	size += workers * sizeof(SharedWorker);
+
+	void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+	{
+		cout << "Couldn't allocate shared memory for the worker processes" << endl;
+		exit(1);
+	}
+
+	char *base = (char *) memory;
+	SharedFrame shared;
+	shared.header = new (base) SharedHeader();
+	shared.doneBits = new (base + bitsOffset) std::atomic<uint64_t>[bitmapWords]();
+	shared.tiles = new (base + tilesOffset) SharedTile[tiles]();
+	shared.workers = new (base + workersOffset) SharedWorker[workers]();
+
+	std::vector<pid_t> pids(workers, -1);
+	auto spawn = [&](int slot) {
+		shared.workers[slot].tileStartedNs.store(0);
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			worker_main(settings, frame, shared, tiles, slot, yPosSt, yPosEnd);
+			_exit(0);
+		}
+		if (pid < 0)
+		{
+			const int error = errno;
+			kill_workers(pids);
+			cout << "Couldn't start a worker process: " << strerror(error) << endl;
+			exit(1);
+		}
+		pids[slot] = pid;
+	};
+	for (int slot = 0; slot < workers; ++slot)
+	{
+		spawn(slot);
+	}
+
+	int restarts = 0;
+	int alive = workers;
+	while (alive > 0)
+	{
+		// Reap any of our workers that have exited, normally or not. Only
+		// the pids we started: other children of this process aren't ours.
+		int reaped = 0;
+		for (int slot = 0; slot < workers; ++slot)
+		{
+			if (pids[slot] <= 0)
+			{
+				continue;
+			}
+
+			int status;
+			pid_t pid;
+			do
+			{
+				pid = waitpid(pids[slot], &status, WNOHANG);
+			} while (pid < 0 && errno == EINTR);
+			if (pid == 0)
+			{
+				continue;
+			}
+			if (pid < 0)
+			{
+				const int error = errno;
+				kill_workers(pids);
+				cout << "Lost track of a worker process: " << strerror(error) << endl;
+				exit(1);
+			}
+
+			++reaped;
+			pids[slot] = -1;
+			--alive;
+
+			if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+			{
+				continue;
+			}
+
+			// The worker crashed or was killed. Put its tile back for someone
+			// else, unless it has already failed too often, in which case the
+			// image can't be finished.
+			for (int tile = 0; tile < tiles; ++tile)
+			{
+				if (shared.tiles[tile].owner.load() != slot + 1 || tile_done(shared, tile))
+				{
+					continue;
+				}
+
+				if (shared.tiles[tile].attempts.load() >= MAX_TILE_ATTEMPTS)
+				{
+					kill_workers(pids);
+					cout << "Rows " << yPosSt + tile * TILE_ROWS << " to " << std::min(yPosSt + (tile + 1) * TILE_ROWS, yPosEnd)
+						<< " failed " << MAX_TILE_ATTEMPTS << " times, so the render was abandoned." << endl;
+					exit(1);
+				}
+				shared.tiles[tile].owner.store(0);
+			}
+
+			if (shared.header->tilesDone.load() < tiles)
+			{
+				spawn(slot);
+				++alive;
+				++restarts;
+			}
+		}
+		if (reaped > 0)
+		{
+			continue;
+		}
+
+		// If asked to, kill anyone who's been stuck on one tile too long.
+		for (int slot = 0; slot < workers && settings.hangTimeout > 0.0; ++slot)
+		{
+			const int64_t started = shared.workers[slot].tileStartedNs.load();
+			if (pids[slot] > 0 && started != 0 && (now_ns() - started) / 1e9 > settings.hangTimeout)
+			{
+				kill(pids[slot], SIGKILL);
+			}
+		}
+		usleep(1000);
+	}
+
+	// Every worker has gone, so this should only happen if they all exited
+	// cleanly without finishing, but never hand back a half-drawn frame.
+	const int tilesDone = shared.header->tilesDone.load();
+	if (tilesDone < tiles)
+	{
+		cout << "The worker processes stopped with " << tiles - tilesDone << " tile(s) still to render." << endl;
+		exit(1);
+	}
+
+	munmap(memory, size);
+
+	if (restarts > 0)
+	{
+		cout << restarts << " worker process(es) crashed or hung and were restarted." << endl;
+	}
+}
+
+#endif
@@ -0,0 +1,18 @@
+// Rendering in separate worker processes
+// Workers are forked children that write straight into the frame, whose
+// iterations are in shared memory, and mark tiles complete in a lock-free
+// bitmap, so a kernel that crashes only takes down its own process. The
+// parent notices and hands the unfinished tile to a replacement. Workers
+// that hang are only killed if settings.hangTimeout is set.
+
+#pragma once
+
+#include "render.h"
+#include "scheduler.h"
+
+// If a tile takes down this many workers, the render fails.
+const int MAX_TILE_ATTEMPTS = 3;
+
+// Compute rows [yPosSt, yPosEnd) of the frame using settings.threads worker
+// processes, each rendering TILE_ROWS rows at a time.
+void render_processes(const RenderSettings &settings, Frame &frame, int yPosSt, int yPosEnd);
@@ -0,0 +1,225 @@
+// Rendering the Mandelbrot set into an image
+
+#include "render.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+using std::cout;
+using std::endl;
+using std::ofstream;
+
+const int TGA_HEADER_SIZE = 18;
+
+void *allocate_frame_memory(size_t bytes)
+{
+#ifdef _WIN32
+	return ::operator new(bytes);
+#else
+	void *memory = mmap(nullptr, std::max<size_t>(bytes, 1), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+#endif
+}
+
+void free_frame_memory(void *memory, size_t bytes)
+{
+#ifdef _WIN32
+	::operator delete(memory);
+#else
+	munmap(memory, std::max<size_t>(bytes, 1));
+#endif
+}
+
+Frame::Frame(int width, int height, int maxIterations)
+	: Frame(width, height, maxIterations, 0, height)
+{
+}
+
+Frame::Frame(int width, int height, int maxIterations, int firstRow, int rows)
+	: width(width), height(height), maxIterations(maxIterations), firstRow(firstRow), rows(rows),
+	iterations((size_t) width * rows), image((size_t) width * rows)
+{
+}
+
+double column_real(const View &view, int width, int x)
+{
+	return view.left + (x * (view.right - view.left) / width);
+}
+
+double row_imag(const View &view, int height, int y)
+{
+	return view.top + (y * (view.bottom - view.top) / height);
+}
+
+void compute_points(const Kernel &kernel, const Fractal &fractal, const double *re, const double *im, int count, int maxIterations, int *iterations)
+{
+	if (fractal.julia)
+	{
+		kernel.julia(re, im, count, fractal.cRe, fractal.cIm, maxIterations, iterations);
+	}
+	else
+	{
+		kernel.func(re, im, count, maxIterations, iterations);
+	}
+}
+
+void compute_rows(const Kernel &kernel, const View &view, int width, int height, int maxIterations, int yPosSt, int yPosEnd, int *out, const Fractal &fractal)
+{
+	// Work out the point in the complex plane that
+	// corresponds to each pixel in the output image.
+	// Every row has the same real parts.
+	std::vector<double> re(width), im(width);
+	for (int x = 0; x < width; ++x)
+	{
+		re[x] = column_real(view, width, x);
+	}
+
+	for (int y = yPosSt; y < yPosEnd; ++y)
+	{
+		std::fill(im.begin(), im.end(), row_imag(view, height, y));
+		compute_points(kernel, fractal, re.data(), im.data(), width, maxIterations, out + (size_t) (y - yPosSt) * width);
+	}
+}
+
+void compute_mandelbrot(const Kernel &kernel, const View &view, Frame &frame, int yPosSt, int yPosEnd, const Fractal &fractal)
+{
+	yPosSt = std::max(yPosSt, frame.firstRow);
+	yPosEnd = std::min(yPosEnd, frame.firstRow + frame.rows);
+	if (yPosSt < yPosEnd)
+	{
+		compute_rows(kernel, view, frame.width, frame.height, frame.maxIterations, yPosSt, yPosEnd, frame.row(yPosSt), fractal);
+	}
+}
+
+long long frame_iterations(const Frame &frame)
+{
+	long long total = 0;
+	for (int n : frame.iterations)
+	{
+		total += n;
+	}
+	return total;
+}
+
+uint32_t iteration_colour(int iterations, int maxIterations)
+{
+	if (iterations == maxIterations)
+	{
+		// z didn't escape from the circle.
+		// This point is in the Mandelbrot set.
+		return 0x000000; // black
+	}
+	else
+	{
+		// z escaped within less than MAX_ITERATIONS
+		// iterations. This point isn't in the set.
+
+		int red = 255;
+		int green = 100;
+		int blue = 100;
+		int col = (red << 16) | (green << 8) | (blue);
+
+		return (col*iterations) / maxIterations;
+	}
+}
+
+void colour_mandelbrot(Frame &frame, int yPosSt, int yPosEnd)
+{
+	yPosSt = std::max(yPosSt, frame.firstRow);
+	yPosEnd = std::min(yPosEnd, frame.firstRow + frame.rows);
+
+	for (size_t i = (size_t) (yPosSt - frame.firstRow) * frame.width; i < (size_t) (yPosEnd - frame.firstRow) * frame.width; ++i)
+	{
+		frame.image[i] = iteration_colour(frame.iterations[i], frame.maxIterations);
+	}
+}
+
+size_t tga_size(const Frame &frame)
+{
+	return TGA_HEADER_SIZE + (size_t) frame.width * frame.height * 3;
+}
+
+size_t tga_row_offset(const Frame &frame, int y)
+{
+	return TGA_HEADER_SIZE + (size_t) y * frame.width * 3;
+}
+
+void encode_tga_pixels(const Frame &frame, uint8_t *out, int yPosSt, int yPosEnd)
+{
+	uint8_t *pixel = out;
+	for (int y = yPosSt; y < yPosEnd; ++y)
+	{
+		const uint32_t *colours = frame.imageRow(y);
+		for (int x = 0; x < frame.width; ++x)
+		{
+			*pixel++ = colours[x] & 0xFF; // blue channel
+			*pixel++ = (colours[x] >> 8) & 0xFF; // green channel
+			*pixel++ = (colours[x] >> 16) & 0xFF; // red channel
+		}
+	}
+}
+
+// Format specification: http://www.gamers.org/dEngine/quake3/TGA.txt
+void encode_tga_rows(const Frame &frame, uint8_t *out, int yPosSt, int yPosEnd)
+{
+	const int width = frame.width;
+	const int height = frame.height;
+	yPosEnd = std::min(yPosEnd, height);
+
+	if (yPosSt == 0)
+	{
+		uint8_t header[TGA_HEADER_SIZE] = {
+			0, // no image ID
+			0, // no colour map
+			2, // uncompressed 24-bit image
+			0, 0, 0, 0, 0, // empty colour map specification
+			0, 0, // X origin
+			0, 0, // Y origin
+			(uint8_t) (width & 0xFF), (uint8_t) ((width >> 8) & 0xFF), // width
+			(uint8_t) (height & 0xFF), (uint8_t) ((height >> 8) & 0xFF), // height
+			24, // bits per pixel
+			0, // image descriptor
+		};
+		std::copy(header, header + TGA_HEADER_SIZE, out);
+	}
+
+	encode_tga_pixels(frame, out + tga_row_offset(frame, yPosSt), yPosSt, yPosEnd);
+}
+
+void encode_tga(const Frame &frame, std::vector<uint8_t> &out)
+{
+	out.resize(tga_size(frame));
+	encode_tga_rows(frame, out.data(), 0, frame.height);
+}
+
+void write_tga_data(const std::vector<uint8_t> &data, const char *filename)
+{
+	ofstream outfile(filename, ofstream::binary);
+	outfile.write((const char *) data.data(), data.size());
+
+	outfile.close();
+	if (!outfile)
+	{
+		// An error has occurred at some point since we opened the file.
+		cout << "Error writing to " << filename << endl;
+		exit(1);
+	}
+}
+
+void write_tga(const Frame &frame, const char *filename)
+{
+	std::vector<uint8_t> data;
+	encode_tga(frame, data);
+	write_tga_data(data, filename);
+}
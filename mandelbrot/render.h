@@ -0,0 +1,146 @@
+// Rendering the Mandelbrot set into an image
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "kernels.h"
+
+// The default size of the image to generate.
+const int WIDTH = 1920;
+const int HEIGHT = 1024;
+
+// The number of times to iterate before we assume that a point isn't in the
+// Mandelbrot set.
+// (You may need to turn this up if you zoom further into the set.)
+const int MAX_ITERATIONS = 1000;
+
+// A region of the complex plane to plot.
+struct View
+{
+	double left, right, top, bottom;
+};
+
+// This shows the whole set.
+const View WHOLE_SET = { -2.0, 1.0, 1.125, -1.125 };
+
+// This zooms in on an interesting bit of detail.
+const View ZOOMED = { -0.751085, -0.734975, 0.118378, 0.134488 };
+
+// What to plot at each point of a view.
+struct Fractal
+{
+	// False for the Mandelbrot set, where each point is c and z starts at 0.
+	// True for the Julia set of c = cRe + cIm i, where each point is where z
+	// starts.
+	bool julia = false;
+	double cRe = 0.0, cIm = 0.0;
+};
+
+// Julia sets are centred on (0, 0), and this shows all of most of them.
+// At the default size each pixel is exactly 2^-9 across, so the pixels on
+// either side of (0, 0) are exact negatives of each other; see symmetry.h.
+const View JULIA_SET = { -1.875, 1.875, 1.0, -1.0 };
+
+// Memory for a frame's iteration counts. Where fork() is available it's
+// shared with any child processes forked while the frame exists, so the
+// process scheduler's workers write their tiles straight into the frame
+// rather than into a buffer that has to be copied; see process_pool.h.
+void *allocate_frame_memory(size_t bytes);
+void free_frame_memory(void *memory, size_t bytes);
+
+template <typename T>
+struct FrameAllocator
+{
+	typedef T value_type;
+
+	FrameAllocator() = default;
+	template <typename U> FrameAllocator(const FrameAllocator<U> &) {}
+
+	T *allocate(size_t n) { return (T *) allocate_frame_memory(n * sizeof(T)); }
+	void deallocate(T *p, size_t n) { free_frame_memory(p, n * sizeof(T)); }
+
+	bool operator==(const FrameAllocator &) const { return true; }
+	bool operator!=(const FrameAllocator &) const { return false; }
+};
+
+// A rendered image: the iteration count for each pixel, and the colours
+// worked out from them.
+// A frame can also hold just a band of rows from a larger image, so that
+// pixel coordinates come out exactly as they would for the whole image.
+struct Frame
+{
+	Frame(int width = WIDTH, int height = HEIGHT, int maxIterations = MAX_ITERATIONS);
+
+	// Just rows [firstRow, firstRow + rows) of a width x height image.
+	Frame(int width, int height, int maxIterations, int firstRow, int rows);
+
+	int width;
+	int height;
+	int maxIterations;
+
+	// The rows of the image that are stored.
+	int firstRow;
+	int rows;
+
+	// Row-major, width * rows entries each.
+	std::vector<int, FrameAllocator<int>> iterations;
+
+	// Each pixel is represented as 0xRRGGBB.
+	std::vector<uint32_t> image;
+
+	int *row(int y) { return &iterations[(size_t) (y - firstRow) * width]; }
+	const int *row(int y) const { return &iterations[(size_t) (y - firstRow) * width]; }
+	uint32_t *imageRow(int y) { return &image[(size_t) (y - firstRow) * width]; }
+	const uint32_t *imageRow(int y) const { return &image[(size_t) (y - firstRow) * width]; }
+};
+
+// The real part of the points in column x of a width-column image.
+double column_real(const View &view, int width, int x);
+
+// The imaginary part of the points in row y of a height-row image.
+double row_imag(const View &view, int height, int y);
+
+// Run the kernel on "count" points of the fractal.
+void compute_points(const Kernel &kernel, const Fractal &fractal, const double *re, const double *im, int count, int maxIterations, int *iterations);
+
+// Compute the iteration counts for rows [yPosSt, yPosEnd) of a width x height
+// image, writing them to out (which starts at row yPosSt).
+void compute_rows(const Kernel &kernel, const View &view, int width, int height, int maxIterations, int yPosSt, int yPosEnd, int *out, const Fractal &fractal = Fractal());
+
+// Compute the iteration counts for rows [yPosSt, yPosEnd) of the frame.
+// The view specifies the region on the complex plane to plot.
+void compute_mandelbrot(const Kernel &kernel, const View &view, Frame &frame, int yPosSt, int yPosEnd, const Fractal &fractal = Fractal());
+
+// The total of the iteration counts of every pixel in the frame.
+long long frame_iterations(const Frame &frame);
+
+// The colour, as 0xRRGGBB, of a pixel that took the given number of iterations.
+uint32_t iteration_colour(int iterations, int maxIterations);
+
+// Work out the colours for rows [yPosSt, yPosEnd) from their iteration counts.
+void colour_mandelbrot(Frame &frame, int yPosSt, int yPosEnd);
+
+// The size in bytes of the TGA encoding of a frame.
+size_t tga_size(const Frame &frame);
+
+// Where row y's pixels start in the TGA encoding of a frame.
+size_t tga_row_offset(const Frame &frame, int y);
+
+// Encode just the pixels of rows [yPosSt, yPosEnd), starting at "out".
+void encode_tga_pixels(const Frame &frame, uint8_t *out, int yPosSt, int yPosEnd);
+
+// Encode rows [yPosSt, yPosEnd) of the image into "out", which must be
+// tga_size() bytes. Row 0 also writes the header.
+void encode_tga_rows(const Frame &frame, uint8_t *out, int yPosSt, int yPosEnd);
+
+// Encode the whole image as a TGA file in memory.
+void encode_tga(const Frame &frame, std::vector<uint8_t> &out);
+
+// Write an already-encoded TGA image to a file with the given name.
+void write_tga_data(const std::vector<uint8_t> &data, const char *filename);
+
+// Write the image to a TGA file with the given name.
+void write_tga(const Frame &frame, const char *filename);
@@ -0,0 +1,457 @@
+// Benchmark results file
+
+#include "results.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using std::cout;
+using std::endl;
+using std::ofstream;
+using std::string;
+
+// These are normally passed in by the build system.
+#ifndef MANDELBROT_GIT_HASH
+#define MANDELBROT_GIT_HASH "unknown"
+#endif
+
+#ifndef MANDELBROT_CXX_FLAGS
+#if defined(_MSC_VER)
+#define MANDELBROT_STRINGIFY2(x) #x
+#define MANDELBROT_STRINGIFY(x) MANDELBROT_STRINGIFY2(x)
+#define MANDELBROT_CXX_FLAGS "MSVC " MANDELBROT_STRINGIFY(_MSC_FULL_VER)
+#elif defined(__VERSION__)
+#define MANDELBROT_CXX_FLAGS __VERSION__
+#else
+#define MANDELBROT_CXX_FLAGS "unknown"
+#endif
+#endif
+
+#ifdef _WIN32
+// Read an environment variable, returning "" if it isn't set.
+static string get_env(const char *name)
+{
+	char *value = nullptr;
+	size_t size = 0;
+	if (_dupenv_s(&value, &size, name) != 0 || value == nullptr)
+	{
+		return "";
+	}
+	string result(value);
+	free(value);
+	return result;
+}
+#endif
+
+static string detect_hostname()
+{
+#ifdef _WIN32
+	string name = get_env("COMPUTERNAME");
+#else
+	char buffer[256] = {};
+	string name;
+	if (gethostname(buffer, sizeof buffer - 1) == 0)
+	{
+		name = buffer;
+	}
+#endif
+	return name.empty() ? "unknown" : name;
+}
+
+static string detect_cpu_model()
+{
+#ifdef _WIN32
+	string model = get_env("PROCESSOR_IDENTIFIER");
+#else
+	// The first "model name" line in /proc/cpuinfo describes the CPU.
+	string model;
+	std::ifstream cpuinfo("/proc/cpuinfo");
+	string line;
+	while (std::getline(cpuinfo, line))
+	{
+		if (line.compare(0, 10, "model name") == 0)
+		{
+			size_t colon = line.find(':');
+			if (colon != string::npos)
+			{
+				model = line.substr(line.find_first_not_of(" \t", colon + 1));
+			}
+			break;
+		}
+	}
+#endif
+	return model.empty() ? "unknown" : model;
+}
+
+Environment detect_environment()
+{
+	Environment env;
+	env.gitHash = MANDELBROT_GIT_HASH;
+	env.hostname = detect_hostname();
+	env.cpuModel = detect_cpu_model();
+	env.compilerFlags = MANDELBROT_CXX_FLAGS;
+	return env;
+}
+
+// The current time in UTC, as an ISO 8601 string.
+static string timestamp()
+{
+	std::time_t now = std::time(nullptr);
+	std::tm utc;
+#ifdef _WIN32
+	gmtime_s(&utc, &now);
+#else
+	gmtime_r(&now, &utc);
+#endif
+	char buffer[32];
+	std::strftime(buffer, sizeof buffer, "%Y-%m-%dT%H:%M:%SZ", &utc);
+	return buffer;
+}
+
+// Quote a CSV field if it contains anything that would confuse a reader.
+static string csv_field(const string &value)
+{
+	if (value.find_first_of(",\"\n") == string::npos)
+	{
+		return value;
+	}
+
+	string quoted = "\"";
+	for (char ch : value)
+	{
+		if (ch == '"')
+		{
+			quoted += '"';
+		}
+		quoted += ch;
+	}
+	return quoted + "\"";
+}
+
+static string json_string(const string &value)
+{
+	string quoted = "\"";
+	for (char ch : value)
+	{
+		if (ch == '"' || ch == '\\')
+		{
+			quoted += '\\';
+		}
+		quoted += ch;
+	}
+	return quoted + "\"";
+}
+
+static bool ends_with(const string &s, const string &suffix)
+{
+	return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// The columns of the CSV file, in order.
+static const char *CSV_HEADER =
+	"timestamp,git_hash,hostname,cpu_model,compiler_flags,"
+	"benchmark,kernel,scheduler,threads,symmetry,pipeline,"
+	"left,right,top,bottom,width,height,max_iterations,"
+	"time_ns,time_ms,ns_per_pixel,mpixels_per_sec,"
+	"iterations,energy_j,iterations_per_joule";
+
+ResultsWriter::ResultsWriter(const string &filename)
+	: name(filename), json(ends_with(filename, ".json") || ends_with(filename, ".jsonl")), env(detect_environment())
+{
+	// Only write a header if we're starting a new file; otherwise we append
+	// to the results of earlier runs. A CSV file with different columns was
+	// written by another build, so it's moved out of the way rather than
+	// mixing rows that don't match its header.
+	bool isNew;
+	{
+		std::ifstream existing(filename);
+		isNew = !existing || existing.peek() == std::ifstream::traits_type::eof();
+
+		string header;
+		if (!isNew && !json && (!std::getline(existing, header) || header != CSV_HEADER))
+		{
+			existing.close();
+			string moved;
+			for (int n = 1; moved.empty() || std::ifstream(moved); ++n)
+			{
+				moved = filename + "." + std::to_string(n);
+			}
+			if (std::rename(filename.c_str(), moved.c_str()) != 0)
+			{
+				cout << filename << " has different columns from this build's results, and couldn't be moved aside" << endl;
+				exit(1);
+			}
+			cout << filename << " has different columns from this build's results, so it was moved to " << moved << endl;
+			isNew = true;
+		}
+	}
+
+	out.open(filename, ofstream::app);
+	if (!out)
+	{
+		cout << "Error opening " << filename << endl;
+		exit(1);
+	}
+
+	if (isNew && !json)
+	{
+		out << CSV_HEADER << '\n';
+	}
+}
+
+void ResultsWriter::write(const Sample &sample)
+{
+	const long long pixels = (long long) sample.width * sample.height;
+	const double nsPerPixel = pixels > 0 ? (double) sample.timeNs / pixels : 0.0;
+	const double mpixelsPerSec = sample.timeNs > 0 ? (pixels * 1000.0) / sample.timeNs : 0.0;
+	const double iterationsPerJoule = sample.energyJ > 0.0 ? sample.iterations / sample.energyJ : 0.0;
+
+	// The view needs full precision to tell deep zooms apart.
+	std::ostringstream row;
+	row.precision(17);
+
+	if (json)
+	{
+		row << "{\"timestamp\":" << json_string(timestamp())
+			<< ",\"git_hash\":" << json_string(env.gitHash)
+			<< ",\"hostname\":" << json_string(env.hostname)
+			<< ",\"cpu_model\":" << json_string(env.cpuModel)
+			<< ",\"compiler_flags\":" << json_string(env.compilerFlags)
+			<< ",\"benchmark\":" << json_string(sample.benchmark)
+			<< ",\"kernel\":" << json_string(sample.kernel)
+			<< ",\"scheduler\":" << json_string(sample.scheduler)
+			<< ",\"threads\":" << sample.threads
+			<< ",\"symmetry\":" << json_string(sample.symmetry)
+			<< ",\"pipeline\":" << json_string(sample.pipeline)
+			<< ",\"left\":" << sample.left
+			<< ",\"right\":" << sample.right
+			<< ",\"top\":" << sample.top
+			<< ",\"bottom\":" << sample.bottom
+			<< ",\"width\":" << sample.width
+			<< ",\"height\":" << sample.height
+			<< ",\"max_iterations\":" << sample.maxIterations
+			<< ",\"time_ns\":" << sample.timeNs << std::setprecision(6)
+			<< ",\"time_ms\":" << sample.timeNs / 1e6
+			<< ",\"ns_per_pixel\":" << nsPerPixel
+			<< ",\"mpixels_per_sec\":" << mpixelsPerSec
+			<< ",\"iterations\":" << sample.iterations
+			<< ",\"energy_j\":" << sample.energyJ
+			<< ",\"iterations_per_joule\":" << iterationsPerJoule
+			<< "}";
+	}
+	else
+	{
+		row << csv_field(timestamp())
+			<< ',' << csv_field(env.gitHash)
+			<< ',' << csv_field(env.hostname)
+			<< ',' << csv_field(env.cpuModel)
+			<< ',' << csv_field(env.compilerFlags)
+			<< ',' << csv_field(sample.benchmark)
+			<< ',' << csv_field(sample.kernel)
+			<< ',' << csv_field(sample.scheduler)
+			<< ',' << sample.threads
+			<< ',' << csv_field(sample.symmetry)
+			<< ',' << csv_field(sample.pipeline)
+			<< ',' << sample.left
+			<< ',' << sample.right
+			<< ',' << sample.top
+			<< ',' << sample.bottom
+			<< ',' << sample.width
+			<< ',' << sample.height
+			<< ',' << sample.maxIterations
+			<< ',' << sample.timeNs << std::setprecision(6)
+			<< ',' << sample.timeNs / 1e6
+			<< ',' << nsPerPixel
+			<< ',' << mpixelsPerSec
+			<< ',' << sample.iterations
+			<< ',' << sample.energyJ
+			<< ',' << iterationsPerJoule;
+	}
+
+	out << row.str() << '\n';
+	out.flush();
+	if (!out)
+	{
+		cout << "Error writing to " << name << endl;
+		exit(1);
+	}
+}
+
+// Split one CSV line into fields, undoing csv_field's quoting.
+static std::vector<string> split_csv(const string &line)
+{
+	std::vector<string> fields;
+	string field;
+	bool quoted = false;
+
+	for (size_t i = 0; i < line.size(); ++i)
+	{
+		char ch = line[i];
+		if (quoted)
+		{
+			if (ch == '"' && i + 1 < line.size() && line[i + 1] == '"')
+			{
+				field += '"';
+				++i;
+			}
+			else if (ch == '"')
+			{
+				quoted = false;
+			}
+			else
+			{
+				field += ch;
+			}
+		}
+		else if (ch == '"')
+		{
+			quoted = true;
+		}
+		else if (ch == ',')
+		{
+			fields.push_back(field);
+			field.clear();
+		}
+		else if (ch != '\r')
+		{
+			field += ch;
+		}
+	}
+	fields.push_back(field);
+
+	return fields;
+}
+
+// Split one JSON object, as written by ResultsWriter, into key/value pairs.
+// This only handles the flat objects we write ourselves.
+static std::map<string, string> split_json(const string &line)
+{
+	std::map<string, string> values;
+	size_t pos = 0;
+
+	auto read_string = [&](string &out) {
+		out.clear();
+		++pos; // opening quote
+		while (pos < line.size() && line[pos] != '"')
+		{
+			if (line[pos] == '\\' && pos + 1 < line.size())
+			{
+				++pos;
+			}
+			out += line[pos++];
+		}
+		++pos; // closing quote
+	};
+
+	while ((pos = line.find('"', pos)) != string::npos)
+	{
+		string key, value;
+		read_string(key);
+		pos = line.find(':', pos);
+		if (pos == string::npos)
+		{
+			break;
+		}
+		pos = line.find_first_not_of(" \t", pos + 1);
+		if (pos == string::npos)
+		{
+			break;
+		}
+
+		if (line[pos] == '"')
+		{
+			read_string(value);
+		}
+		else
+		{
+			size_t end = line.find_first_of(",}", pos);
+			value = line.substr(pos, end - pos);
+			pos = end;
+		}
+		values[key] = value;
+	}
+
+	return values;
+}
+
+static Sample sample_from_fields(const std::map<string, string> &fields)
+{
+	auto get = [&](const char *key) -> string {
+		auto it = fields.find(key);
+		return it == fields.end() ? "" : it->second;
+	};
+	auto get_number = [&](const char *key) -> double {
+		string value = get(key);
+		return value.empty() ? 0.0 : std::atof(value.c_str());
+	};
+
+	Sample sample;
+	sample.benchmark = get("benchmark");
+	sample.kernel = get("kernel");
+	sample.scheduler = get("scheduler");
+	sample.threads = (int) get_number("threads");
+	sample.symmetry = get("symmetry");
+	sample.pipeline = get("pipeline");
+	sample.left = get_number("left");
+	sample.right = get_number("right");
+	sample.top = get_number("top");
+	sample.bottom = get_number("bottom");
+	sample.width = (int) get_number("width");
+	sample.height = (int) get_number("height");
+	sample.maxIterations = (int) get_number("max_iterations");
+	sample.timeNs = std::atoll(get("time_ns").c_str());
+	sample.iterations = std::atoll(get("iterations").c_str());
+	sample.energyJ = get("energy_j").empty() ? -1.0 : get_number("energy_j");
+	return sample;
+}
+
+std::vector<Sample> read_results(const string &filename)
+{
+	std::ifstream in(filename);
+	if (!in)
+	{
+		cout << "Error reading " << filename << endl;
+		exit(1);
+	}
+
+	std::vector<Sample> samples;
+	std::vector<string> header;
+	string line;
+	while (std::getline(in, line))
+	{
+		if (line.empty() || line == "\r")
+		{
+			continue;
+		}
+
+		if (line[0] == '{')
+		{
+			samples.push_back(sample_from_fields(split_json(line)));
+		}
+		else if (header.empty())
+		{
+			header = split_csv(line);
+		}
+		else
+		{
+			std::vector<string> values = split_csv(line);
+			std::map<string, string> fields;
+			for (size_t i = 0; i < header.size() && i < values.size(); ++i)
+			{
+				fields[header[i]] = values[i];
+			}
+			samples.push_back(sample_from_fields(fields));
+		}
+	}
+
+	return samples;
+}
@@ -0,0 +1,80 @@
+// Benchmark results file
+// Each timed render is written as one self-describing record, so that runs on
+// different machines and builds can be compared without hand bookkeeping.
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// One timed render and the configuration that produced it.
+struct Sample
+{
+	std::string benchmark; // name of the benchmark case, e.g. "threads_4"
+	std::string kernel;
+	std::string scheduler;
+	int threads = 1;
+
+	// Whether mirrored rows were copied ("on" or "off"; see symmetry.h),
+	// and how the image was coloured and encoded: "none" if it wasn't,
+	// "joined" after the render, or "streamed" or "coroutines" during it.
+	// Both make a big difference to the time, so baselines only compare
+	// samples that agree on them. Files from before they were recorded
+	// read back as "".
+	std::string symmetry = "off";
+	std::string pipeline = "none";
+
+	// The region of the complex plane that was plotted.
+	double left = 0.0, right = 0.0, top = 0.0, bottom = 0.0;
+
+	int width = 0;
+	int height = 0;
+	int maxIterations = 0;
+
+	long long timeNs = 0;
+
+	// Escape-loop iterations the render represents, or 0 if not counted.
+	long long iterations = 0;
+
+	// Energy used by the CPU packages during the render, or -1 if it
+	// couldn't be measured. See energy.h.
+	double energyJ = -1.0;
+};
+
+// Details of the machine and build, which are the same for every sample in a run.
+struct Environment
+{
+	std::string gitHash;
+	std::string hostname;
+	std::string cpuModel;
+	std::string compilerFlags;
+};
+
+// Work out the environment we're running in.
+Environment detect_environment();
+
+// Appends samples to a results file.
+// Files ending in ".json" or ".jsonl" get one JSON object per line; anything
+// else is written as CSV, with a header if the file is new. An existing CSV
+// file whose header isn't this build's is renamed to filename.1 (or .2, and
+// so on) and a new file started.
+class ResultsWriter
+{
+public:
+	explicit ResultsWriter(const std::string &filename);
+
+	void write(const Sample &sample);
+
+	const std::string &filename() const { return name; }
+
+private:
+	std::string name;
+	std::ofstream out;
+	bool json;
+	Environment env;
+};
+
+// Read back the samples from a results file written by ResultsWriter.
+// Exits with an error if the file can't be read.
+std::vector<Sample> read_results(const std::string &filename);
@@ -0,0 +1,178 @@
+// Splitting a render across threads
+
+#include "scheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "process_pool.h"
+#include "symmetry.h"
+#include "tile_tracker.h"
+
+const char *scheduler_name(Scheduler scheduler)
+{
+	switch (scheduler)
+	{
+	case Scheduler::Static:
+		return "static";
+	case Scheduler::Dynamic:
+		return "dynamic";
+	case Scheduler::Process:
+		return "process";
+	}
+	return "unknown";
+}
+
+bool parse_scheduler(const std::string &name, Scheduler &scheduler)
+{
+	if (name == "static")
+	{
+		scheduler = Scheduler::Static;
+	}
+	else if (name == "dynamic")
+	{
+		scheduler = Scheduler::Dynamic;
+	}
+	else if (name == "process")
+	{
+		scheduler = Scheduler::Process;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+// Claim TILE_ROWS rows at a time from nextRow until they run out.
+static void dynamic_worker(const RenderSettings &settings, Frame &frame, std::atomic<int> &nextRow, int yPosEnd)
+{
+	while (true)
+	{
+		int start = nextRow.fetch_add(TILE_ROWS);
+		if (start >= yPosEnd)
+		{
+			break;
+		}
+		compute_mandelbrot(*settings.kernel, settings.view, frame, start, std::min(start + TILE_ROWS, yPosEnd), settings.fractal);
+	}
+}
+
+void render_rows(const RenderSettings &settings, Frame &frame, int yPosSt, int yPosEnd)
+{
+	if (settings.scheduler == Scheduler::Process)
+	{
+		render_processes(settings, frame, yPosSt, yPosEnd);
+		return;
+	}
+
+	const int threads = std::max(1, settings.threads);
+	if (threads == 1)
+	{
+		compute_mandelbrot(*settings.kernel, settings.view, frame, yPosSt, yPosEnd, settings.fractal);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	std::atomic<int> nextRow(yPosSt);
+
+	for (int t = 0; t < threads; ++t)
+	{
+		if (settings.scheduler == Scheduler::Static)
+		{
+			// Rounding means some bands are a row taller than others.
+			int rows = yPosEnd - yPosSt;
+			int start = yPosSt + (int) ((long long) rows * t / threads);
+			int end = yPosSt + (int) ((long long) rows * (t + 1) / threads);
+			workers.push_back(std::thread(compute_mandelbrot, std::cref(*settings.kernel), std::cref(settings.view), std::ref(frame), start, end, std::cref(settings.fractal)));
+		}
+		else
+		{
+			workers.push_back(std::thread(dynamic_worker, std::cref(settings), std::ref(frame), std::ref(nextRow), yPosEnd));
+		}
+	}
+
+	for (std::thread &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void render_frame(const RenderSettings &settings, Frame &frame)
+{
+	// Compute each run of rows that aren't mirror images, then copy the rest.
+	const RowPlan plan = plan_rows(settings, frame, frame.rows);
+	for (const auto &run : plan.tiles)
+	{
+		render_rows(settings, frame, run.first, run.second);
+	}
+	mirror_rows(plan, frame, frame.firstRow, frame.firstRow + frame.rows);
+}
+
+// Compute tiles until they run out, reporting each one to the tracker.
+static void streaming_worker(const RenderSettings &settings, Frame &frame, const RowPlan &plan, std::atomic<int> &nextTile, TileTracker &tracker)
+{
+	while (true)
+	{
+		int tile = nextTile.fetch_add(1);
+		if (tile >= tracker.tiles())
+		{
+			break;
+		}
+		compute_mandelbrot(*settings.kernel, settings.view, frame, plan.tiles[tile].first, plan.tiles[tile].second, settings.fractal);
+		tracker.complete(tile);
+	}
+}
+
+void render_streaming(const RenderSettings &settings, Frame &frame, const RowsReady &ready)
+{
+	if (settings.scheduler == Scheduler::Process)
+	{
+		// The worker processes only hand back the finished frame.
+		render_frame(settings, frame);
+		ready(frame.firstRow, frame.firstRow + frame.rows);
+		return;
+	}
+
+	// Only the rows that aren't mirror images are computed; the others
+	// are copied from them once they're done.
+	const RowPlan plan = plan_rows(settings, frame, TILE_ROWS);
+
+	const int threads = std::max(1, settings.threads);
+	TileTracker tracker((int) plan.tiles.size());
+	std::atomic<int> nextTile(0);
+
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threads; ++t)
+	{
+		workers.push_back(std::thread(streaming_worker, std::cref(settings), std::ref(frame), std::cref(plan), std::ref(nextTile), std::ref(tracker)));
+	}
+
+	while (!tracker.drained())
+	{
+		for (int tile = tracker.next_completed(); tile >= 0; tile = tracker.next_completed())
+		{
+			ready(plan.tiles[tile].first, plan.tiles[tile].second);
+			mirror_rows(plan, frame, plan.tiles[tile].first, plan.tiles[tile].second, ready);
+		}
+
+		int tile = nextTile.fetch_add(1);
+		if (tile < tracker.tiles())
+		{
+			compute_mandelbrot(*settings.kernel, settings.view, frame, plan.tiles[tile].first, plan.tiles[tile].second, settings.fractal);
+			tracker.complete(tile);
+		}
+		else
+		{
+			// Everything has been handed out; wait for the stragglers.
+			std::this_thread::yield();
+		}
+	}
+
+	for (std::thread &worker : workers)
+	{
+		worker.join();
+	}
+}
@@ -0,0 +1,70 @@
+// Splitting a render across threads
+
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "kernels.h"
+#include "render.h"
+
+// How rows are shared out between threads.
+enum class Scheduler
+{
+	// One contiguous band of rows per thread.
+	Static,
+
+	// Threads repeatedly claim the next TILE_ROWS rows until there are none left.
+	Dynamic,
+
+	// Like Dynamic, but each worker is a separate process, so a crash or
+	// hang only loses that worker's tile. See process_pool.h.
+	Process,
+};
+
+// The number of rows in each tile handed out by the dynamic and process
+// schedulers.
+const int TILE_ROWS = 16;
+
+// Everything needed to compute a frame, apart from its size.
+struct RenderSettings
+{
+	View view;
+	const Kernel *kernel;
+
+	// The Mandelbrot set unless it says otherwise.
+	Fractal fractal;
+	int threads;
+	Scheduler scheduler;
+
+	// Copy rows that are mirror images of others (or, for a Julia set,
+	// rotated copies) rather than computing them. See symmetry.h.
+	bool symmetry = true;
+
+	// With the process scheduler, kill a worker that has spent longer than
+	// this many seconds on one tile and give the tile to another. 0 means
+	// never: a slow tile isn't necessarily a hung one.
+	double hangTimeout = 0.0;
+};
+
+const char *scheduler_name(Scheduler scheduler);
+
+// Look up a scheduler by name. Returns false if there isn't one.
+bool parse_scheduler(const std::string &name, Scheduler &scheduler);
+
+// Compute the iteration counts for rows [yPosSt, yPosEnd) of the frame using
+// settings.threads threads.
+void render_rows(const RenderSettings &settings, Frame &frame, int yPosSt, int yPosEnd);
+
+// Compute the iteration counts for the whole frame, using the set's
+// symmetry if settings.symmetry is set.
+void render_frame(const RenderSettings &settings, Frame &frame);
+
+// Called with rows [yPosSt, yPosEnd) once they have been computed.
+typedef std::function<void(int yPosSt, int yPosEnd)> RowsReady;
+
+// Compute the whole frame a tile of TILE_ROWS rows at a time, calling ready
+// on this thread for each tile as soon as it is finished, while the other
+// threads carry on computing. When no tile is waiting, this thread computes
+// tiles too. Tiles are always handed out dynamically.
+void render_streaming(const RenderSettings &settings, Frame &frame, const RowsReady &ready);
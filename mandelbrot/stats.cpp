@@ -0,0 +1,92 @@
+// Statistics for comparing benchmark timings
+
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+double median(std::vector<double> samples)
+{
+	if (samples.empty())
+	{
+		return 0.0;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	size_t middle = samples.size() / 2;
+
+	// Check for even num of elements
+	if (samples.size() % 2 == 0)
+	{
+		return (samples[middle - 1] + samples[middle]) / 2.0;
+	}
+	else
+	{
+		return samples[middle];
+	}
+}
+
+MannWhitneyResult mann_whitney_u(const std::vector<double> &baseline, const std::vector<double> &current)
+{
+	MannWhitneyResult result = { 0.0, 0.0, 1.0 };
+	const double n1 = (double) baseline.size();
+	const double n2 = (double) current.size();
+	if (baseline.empty() || current.empty())
+	{
+		return result;
+	}
+
+	// Rank both samples together; second = true marks the current samples.
+	std::vector<std::pair<double, bool>> all;
+	for (double v : baseline)
+	{
+		all.push_back(std::make_pair(v, false));
+	}
+	for (double v : current)
+	{
+		all.push_back(std::make_pair(v, true));
+	}
+	std::sort(all.begin(), all.end());
+
+	// Tied values all get the average of the ranks they span.
+	double rankSumCurrent = 0.0;
+	double tieTerm = 0.0;
+	for (size_t i = 0; i < all.size();)
+	{
+		size_t j = i;
+		while (j < all.size() && all[j].first == all[i].first)
+		{
+			++j;
+		}
+
+		const double rank = (i + 1 + j) / 2.0;
+		for (size_t k = i; k < j; ++k)
+		{
+			if (all[k].second)
+			{
+				rankSumCurrent += rank;
+			}
+		}
+
+		const double t = (double) (j - i);
+		tieTerm += t * t * t - t;
+		i = j;
+	}
+
+	result.u = rankSumCurrent - n2 * (n2 + 1) / 2.0;
+
+	const double n = n1 + n2;
+	const double meanU = n1 * n2 / 2.0;
+	const double varU = n1 * n2 / 12.0 * ((n + 1) - tieTerm / (n * (n - 1)));
+	if (varU <= 0.0)
+	{
+		// Every value is identical, so there's no evidence either way.
+		return result;
+	}
+
+	// Continuity correction of 0.5 towards the mean.
+	result.z = (result.u - meanU - 0.5) / std::sqrt(varU);
+	result.pValue = 0.5 * std::erfc(result.z / std::sqrt(2.0));
+	return result;
+}
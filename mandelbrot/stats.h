@@ -0,0 +1,21 @@
+// Statistics for comparing benchmark timings
+
+#pragma once
+
+#include <vector>
+
+// The median of a set of samples (0 if there are none).
+double median(std::vector<double> samples);
+
+// Result of a one-sided Mann-Whitney U test.
+struct MannWhitneyResult
+{
+	double u;      // U statistic for the second sample
+	double z;      // normal approximation, with tie correction
+	double pValue; // probability of seeing U this large if the second sample isn't larger
+};
+
+// Test whether the values in "current" tend to be larger than those in
+// "baseline" (i.e. for timings, whether current is slower).
+// Uses the normal approximation, which is reasonable from about 5 samples each.
+MannWhitneyResult mann_whitney_u(const std::vector<double> &baseline, const std::vector<double> &current);
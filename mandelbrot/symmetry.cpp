@@ -0,0 +1,175 @@
+// Using the set's symmetry to avoid computing rows twice
+
+#include "symmetry.h"
+
+#include <algorithm>
+#include <cmath>
+
+// A rotated copy of a row may compute up to this share of its pixels and
+// still be worth making.
+const int MAX_LONE_COLUMNS_PER = 16;
+
+// Find the column at minus the real part of each column, for rotating rows.
+// Returns false if too few columns have one for rotating to be worthwhile.
+static bool plan_columns(const View &view, const Frame &frame, std::vector<int> &columns)
+{
+	columns.assign(frame.width, -1);
+
+	// Columns x and k - x are at +/- the same real part, for:
+	const double k = -2.0 * view.left * frame.width / (view.right - view.left);
+	if (std::fabs(k) >= 2.0 * frame.width)
+	{
+		return false;
+	}
+
+	const int sum = (int) std::lround(k);
+	int lone = 0;
+	for (int x = 0; x < frame.width; ++x)
+	{
+		const int m = sum - x;
+		if (m >= 0 && m < frame.width && column_real(view, frame.width, m) == -column_real(view, frame.width, x))
+		{
+			columns[x] = m;
+		}
+		else
+		{
+			++lone;
+		}
+	}
+	return lone * MAX_LONE_COLUMNS_PER <= frame.width;
+}
+
+RowPlan plan_rows(const RenderSettings &settings, const Frame &frame, int tileRows)
+{
+	RowPlan plan;
+	plan.source.assign(frame.rows, -1);
+	plan.mirror.assign(frame.rows, -1);
+	plan.settings = settings;
+
+	const View &view = settings.view;
+	const int yPosSt = frame.firstRow;
+	const int yPosEnd = frame.firstRow + frame.rows;
+
+	bool useSymmetry = settings.symmetry;
+	if (useSymmetry && settings.fractal.julia)
+	{
+		useSymmetry = plan_columns(view, frame, plan.columns);
+	}
+
+	if (useSymmetry)
+	{
+		// Rows y and k - y are at +/- the same imaginary part, for:
+		const double k = -2.0 * view.top * frame.height / (view.bottom - view.top);
+
+		// Rounding may make that only nearly true, so check every pair.
+		if (std::fabs(k) < 2.0 * frame.height)
+		{
+			const int sum = (int) std::lround(k);
+			for (int y = yPosSt; y < yPosEnd; ++y)
+			{
+				const int m = sum - y;
+				if (m >= yPosSt && m < y && row_imag(view, frame.height, m) == -row_imag(view, frame.height, y))
+				{
+					plan.source[y - yPosSt] = m;
+					plan.mirror[m - yPosSt] = y;
+				}
+			}
+		}
+	}
+
+	// Split the runs of rows that have no source into tiles.
+	int y = yPosSt;
+	while (y < yPosEnd)
+	{
+		if (plan.source[y - yPosSt] >= 0)
+		{
+			++y;
+			continue;
+		}
+
+		int end = y;
+		while (end < yPosEnd && end - y < tileRows && plan.source[end - yPosSt] < 0)
+		{
+			++end;
+		}
+		plan.tiles.push_back(std::make_pair(y, end));
+		y = end;
+	}
+
+	return plan;
+}
+
+// Copy row y to row m rotated by 180 degrees, computing the pixels with no
+// counterpart in row y.
+static void rotate_row(const RowPlan &plan, Frame &frame, int y, int m)
+{
+	const int *from = frame.row(y);
+	int *to = frame.row(m);
+	std::vector<double> re, im;
+	std::vector<int> lone;
+	for (int x = 0; x < frame.width; ++x)
+	{
+		const int c = plan.columns[x];
+		if (c >= 0)
+		{
+			to[x] = from[c];
+		}
+		else
+		{
+			re.push_back(column_real(plan.settings.view, frame.width, x));
+			im.push_back(row_imag(plan.settings.view, frame.height, m));
+			lone.push_back(x);
+		}
+	}
+
+	if (!lone.empty())
+	{
+		std::vector<int> iterations(lone.size());
+		compute_points(*plan.settings.kernel, plan.settings.fractal, re.data(), im.data(), (int) lone.size(), frame.maxIterations, iterations.data());
+		for (size_t i = 0; i < lone.size(); ++i)
+		{
+			to[lone[i]] = iterations[i];
+		}
+	}
+}
+
+void mirror_rows(const RowPlan &plan, Frame &frame, int yPosSt, int yPosEnd, const std::function<void(int yPosSt, int yPosEnd)> &ready)
+{
+	// Mirror images of consecutive rows are consecutive, so report them in bands.
+	int bandSt = 0, bandEnd = 0;
+
+	for (int y = yPosSt; y < yPosEnd; ++y)
+	{
+		const int m = plan.mirror[y - frame.firstRow];
+		if (m < 0)
+		{
+			continue;
+		}
+
+		if (plan.columns.empty())
+		{
+			std::copy(frame.row(y), frame.row(y) + frame.width, frame.row(m));
+		}
+		else
+		{
+			rotate_row(plan, frame, y, m);
+		}
+
+		if (m + 1 == bandSt)
+		{
+			bandSt = m;
+			continue;
+		}
+		if (ready && bandSt < bandEnd)
+		{
+			ready(bandSt, bandEnd);
+		}
+		bandSt = m;
+		bandEnd = m + 1;
+	}
+
+	if (ready && bandSt < bandEnd)
+	{
+		ready(bandSt, bandEnd);
+	}
+}
@@ -0,0 +1,50 @@
+// Using the set's symmetry to avoid computing rows twice
+// The Mandelbrot set is symmetric about the real axis, so if a view
+// contains both a row and its mirror image, only one needs computing.
+// A Julia set is the same when rotated by 180 degrees about (0, 0), so there
+// a row can be copied, back to front, to the row at minus its imaginary part.
+
+#pragma once
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "render.h"
+#include "scheduler.h"
+
+// Which rows of a frame have to be computed, and which can be copied.
+struct RowPlan
+{
+	// Indexed by y - frame.firstRow: the row that row y is a mirror image
+	// of, or -1 if it has to be computed.
+	std::vector<int> source;
+
+	// Indexed by y - frame.firstRow: the row that is a mirror image of row
+	// y, or -1 if there isn't one.
+	std::vector<int> mirror;
+
+	// The rows that have to be computed, in bands [first, second) of no
+	// more than the requested number of rows.
+	std::vector<std::pair<int, int>> tiles;
+
+	// For a Julia set, indexed by x: the column of a row that is copied to
+	// column x of its rotated copy, or -1 if there isn't one and that pixel
+	// has to be computed. Empty when rows are mirrored without rotating.
+	std::vector<int> columns;
+
+	// What's needed to compute those pixels.
+	RenderSettings settings;
+};
+
+// Plan a render of the frame with settings.view and settings.fractal. Rows
+// (and, for Julia sets, columns) are only treated as mirror images if their
+// coordinates are exact negatives of each other, so the result is identical
+// to computing every row.
+// With settings.symmetry false, every row is computed.
+RowPlan plan_rows(const RenderSettings &settings, const Frame &frame, int tileRows);
+
+// Copy each computed row in [yPosSt, yPosEnd) to its mirror image, if it has
+// one, computing any pixels of a rotated copy that have nothing to copy.
+// If ready is given, it's called with each band of rows filled in.
+void mirror_rows(const RowPlan &plan, Frame &frame, int yPosSt, int yPosEnd, const std::function<void(int yPosSt, int yPosEnd)> &ready = nullptr);
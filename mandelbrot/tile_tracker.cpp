@@ -0,0 +1,45 @@
+// Tracking which tiles of a render have finished
+
+#include "tile_tracker.h"
+
+TileTracker::TileTracker(int tiles)
+	: count(tiles), doneBits(new std::atomic<uint64_t>[(tiles + 63) / 64]()),
+	queue(new std::atomic<int>[tiles]), tail(0), head(0)
+{
+	for (int i = 0; i < tiles; ++i)
+	{
+		queue[i].store(-1, std::memory_order_relaxed);
+	}
+}
+
+void TileTracker::complete(int tile)
+{
+	doneBits[tile / 64].fetch_or((uint64_t) 1 << (tile % 64), std::memory_order_release);
+
+	// Every tile is completed exactly once, so the queue can never overflow.
+	// The release store publishes the tile's pixels along with its number.
+	int slot = tail.fetch_add(1, std::memory_order_relaxed);
+	queue[slot].store(tile, std::memory_order_release);
+}
+
+bool TileTracker::done(int tile) const
+{
+	return (doneBits[tile / 64].load(std::memory_order_acquire) >> (tile % 64)) & 1;
+}
+
+int TileTracker::next_completed()
+{
+	if (head == count)
+	{
+		return -1;
+	}
+
+	// A producer may have claimed this slot but not filled it in yet; in
+	// that case we just try again later.
+	int tile = queue[head].load(std::memory_order_acquire);
+	if (tile >= 0)
+	{
+		++head;
+	}
+	return tile;
+}
@@ -0,0 +1,46 @@
+// Tracking which tiles of a render have finished
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Any number of render threads report finished tiles, and a single consumer
+// picks them up in the order they finished, so it can colour and encode
+// them while the rest of the frame is still being computed.
+// Neither side ever takes a lock. Each tile may only be completed once.
+class TileTracker
+{
+public:
+	explicit TileTracker(int tiles);
+
+	// Called by a render thread once it has written a tile.
+	void complete(int tile);
+
+	// Has the tile been completed?
+	bool done(int tile) const;
+
+	// Called by the consumer. Returns the next tile to finish, or -1 if
+	// none has finished since the last call.
+	int next_completed();
+
+	// Has the consumer seen every tile?
+	bool drained() const { return head == count; }
+
+	int tiles() const { return count; }
+
+private:
+	int count;
+
+	// One bit per tile.
+	std::unique_ptr<std::atomic<uint64_t>[]> doneBits;
+
+	// The finished tiles, in order. A slot holds -1 until its producer has
+	// filled it in.
+	std::unique_ptr<std::atomic<int>[]> queue;
+	std::atomic<int> tail;
+
+	// Only touched by the consumer.
+	int head;
+};
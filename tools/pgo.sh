@@ -0,0 +1,40 @@
+#!/bin/sh
+# Two-stage profile-guided optimisation build.
+#
+#   1. Build an instrumented copy (preset pgo-generate) and train it on the
+#      microbenchmarks and the standard benchmark suite.
+#   2. Rebuild using the recorded profile (preset pgo-use).
+#   3. Time the standard suite with the same build minus PGO (preset native)
+#      and compare the PGO build against it, which reports the speedup.
+#
+# Run from anywhere; builds go under build/ in the source tree.
+
+set -e
+cd "$(dirname "$0")/.."
+
+profiles=build/pgo-profiles
+rm -rf "$profiles"
+
+echo "=== Stage 1: instrumented build and training run"
+cmake --preset pgo-generate
+cmake --build --preset pgo-generate
+(cd build/pgo-generate && ./mandelbrot_bench --min-time 0.1 && ./mandelbrot --bench suite)
+
+# Clang writes raw profiles that have to be merged first; GCC reads its
+# .gcda files directly.
+if ls "$profiles"/*.profraw >/dev/null 2>&1; then
+	llvm-profdata merge -output="$profiles/default.profdata" "$profiles"/*.profraw
+fi
+
+echo "=== Stage 2: optimised build using the profile"
+cmake --preset pgo-use
+cmake --build --preset pgo-use
+
+echo "=== Comparing against the same build without PGO"
+cmake --preset native
+cmake --build --preset native
+rm -f build/native/mandelbrotResults.csv build/pgo-use/mandelbrotResults.csv
+(cd build/native && ./mandelbrot --bench suite)
+
+# A huge threshold, because here we only want the report, not a pass/fail.
+(cd build/pgo-use && ./mandelbrot --bench compare --baseline ../native/mandelbrotResults.csv --threshold 1000)